@@ -0,0 +1,153 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/*
+    What the voice is playing, handed from the audio thread to the editor's
+    scope and spectrum without either side ever waiting.
+
+    The audio thread is the only writer and the editor the only reader, so
+    both streams are single-producer single-consumer:
+      - The scope gets one Peak, the lowest and highest sample, for every
+        decimation samples, through an AbstractFifo. When the editor falls
+        behind, new peaks are dropped rather than old ones overwritten.
+      - The spectrum gets fftSize consecutive raw samples at a time. The
+        audio thread fills a frame over however many blocks it takes, hands
+        it over, and captures nothing more until the editor has taken it.
+        Aliasing shows up in the raw samples that the peaks would hide.
+
+    Nothing happens on the audio thread while no editor is listening.
+*/
+class AnalyserFeed
+{
+public:
+    static constexpr int decimation = 32;
+    static constexpr int fftOrder = 11;
+    static constexpr int fftSize = 1 << fftOrder;
+
+    struct Peak
+    {
+        float min, max;
+    };
+
+    /** Audio thread stopped: the rate the samples will be coming at. */
+    void prepare(double newSampleRate) noexcept
+    {
+        sampleRate.store(newSampleRate);
+        peakCount = 0;
+        captured = 0;
+    }
+
+    double getSampleRate() const noexcept { return sampleRate.load(); }
+
+    /** Any thread: whether an editor is reading. Off, pushing costs one atomic load. */
+    void setActive(bool shouldBeActive) noexcept { active.store(shouldBeActive, std::memory_order_relaxed); }
+
+    //==============================================================================
+    /** Audio thread: the voice's next numSamples. */
+    template <typename SampleType>
+    void push(const SampleType* samples, int numSamples) noexcept
+    {
+        if (! active.load(std::memory_order_relaxed))
+            return;
+
+        capture(samples, numSamples);
+
+        for (int done = 0; done < numSamples;)
+        {
+            const int count = juce::jmin(decimation - peakCount, numSamples - done);
+            const auto range = juce::FloatVectorOperations::findMinAndMax(samples + done, count);
+            const auto low = static_cast<float>(range.getStart());
+            const auto high = static_cast<float>(range.getEnd());
+
+            pending = peakCount == 0 ? Peak { low, high } : Peak { juce::jmin(pending.min, low), juce::jmax(pending.max, high) };
+            peakCount += count;
+            done += count;
+
+            if (peakCount == decimation)
+            {
+                writePeak(pending);
+                peakCount = 0;
+            }
+        }
+    }
+
+    //==============================================================================
+    /** Editor: moves up to maxPeaks waiting peaks into dest, oldest first, and returns how many. */
+    int readPeaks(Peak* dest, int maxPeaks) noexcept
+    {
+        int start1, size1, start2, size2;
+        peakFifo.prepareToRead(maxPeaks, start1, size1, start2, size2);
+
+        std::copy_n(peaks.begin() + start1, size1, dest);
+        std::copy_n(peaks.begin() + start2, size2, dest + size1);
+
+        peakFifo.finishedRead(size1 + size2);
+        return size1 + size2;
+    }
+
+    /** Editor: copies fftSize samples into dest and asks for the next frame,
+        or returns false if the audio thread is still filling this one.
+    */
+    bool readSpectrumFrame(float* dest) noexcept
+    {
+        if (frameReady.load(std::memory_order_acquire))
+        {
+            std::copy(frame.begin(), frame.end(), dest);
+            frameReady.store(false, std::memory_order_release);
+            return true;
+        }
+
+        return false;
+    }
+
+private:
+    static constexpr int peakQueueSize = 4096;      // about 2.7 s at 48 kHz
+
+    void writePeak(Peak peak) noexcept
+    {
+        int start1, size1, start2, size2;
+        peakFifo.prepareToWrite(1, start1, size1, start2, size2);
+
+        if (size1 > 0)
+        {
+            peaks[static_cast<size_t>(start1)] = peak;
+            peakFifo.finishedWrite(1);
+        }
+    }
+
+    // The frame belongs to the audio thread while frameReady is false
+    template <typename SampleType>
+    void capture(const SampleType* samples, int numSamples) noexcept
+    {
+        if (frameReady.load(std::memory_order_acquire))
+            return;
+
+        const int count = juce::jmin(fftSize - captured, numSamples);
+
+        for (int i = 0; i < count; ++i)
+            frame[static_cast<size_t>(captured + i)] = static_cast<float>(samples[i]);
+
+        captured += count;
+
+        if (captured == fftSize)
+        {
+            captured = 0;
+            frameReady.store(true, std::memory_order_release);
+        }
+    }
+
+    std::atomic<bool> active { false };
+    std::atomic<double> sampleRate { 44100.0 };
+
+    Peak pending { 0.0f, 0.0f };                // audio thread
+    int peakCount = 0;
+
+    juce::AbstractFifo peakFifo { peakQueueSize };
+    std::array<Peak, peakQueueSize> peaks;
+
+    std::array<float, fftSize> frame;
+    int captured = 0;                           // audio thread
+    std::atomic<bool> frameReady { false };
+};
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "AnalyserFeed.h"
+
+//==============================================================================
+/*
+    A rolling oscilloscope of the voice, built from the feed's min/max peaks.
+
+    The trace lives in an image one pixel per column. New peaks scroll it
+    left and only the new columns are drawn, so a frame costs what arrived
+    since the last one, not the width of the view.
+*/
+class ScopeView : public juce::Component
+{
+public:
+    static constexpr int peaksPerColumn = 4;
+
+    ScopeView()
+    {
+        setInterceptsMouseClicks(false, false);
+    }
+
+    /** Message thread: the peaks read since the last call, oldest first. */
+    void addPeaks(const AnalyserFeed::Peak* peaks, int numPeaks)
+    {
+        for (int i = 0; i < numPeaks; ++i)
+        {
+            const auto& peak = peaks[i];
+            column = columnCount == 0 ? peak : AnalyserFeed::Peak { juce::jmin(column.min, peak.min), juce::jmax(column.max, peak.max) };
+
+            if (++columnCount == peaksPerColumn)
+            {
+                newColumns.push_back(column);
+                columnCount = 0;
+            }
+        }
+
+        if (newColumns.empty())
+            return;
+
+        if (trace.isValid())
+            drawColumns();
+
+        newColumns.clear();
+        repaint();
+    }
+
+    void paint(juce::Graphics& g) override
+    {
+        g.fillAll(juce::Colours::black.withAlpha(0.5f));
+        g.setColour(juce::Colours::white.withAlpha(0.2f));
+        g.drawHorizontalLine(getHeight() / 2, 0.0f, static_cast<float>(getWidth()));
+        g.drawImageAt(trace, 0, 0);
+    }
+
+    void resized() override
+    {
+        trace = juce::Image(juce::Image::ARGB, juce::jmax(1, getWidth()), juce::jmax(1, getHeight()), true);
+        newColumns.reserve(static_cast<size_t>(trace.getWidth()));
+    }
+
+private:
+    void drawColumns()
+    {
+        const int width = trace.getWidth();
+        const int height = trace.getHeight();
+        const int shift = juce::jmin(width, static_cast<int>(newColumns.size()));
+        const float middle = static_cast<float>(height) * 0.5f;
+
+        trace.moveImageSection(0, 0, shift, 0, width - shift, height);
+        trace.clear({ width - shift, 0, shift, height });
+
+        juce::Graphics g(trace);
+        g.setColour(juce::Colours::white);
+
+        // A column spans its lowest and highest sample, at least a pixel tall
+        for (int i = 0; i < shift; ++i)
+        {
+            const auto& peak = newColumns[newColumns.size() - static_cast<size_t>(shift - i)];
+            const float top = middle - juce::jlimit(-1.0f, 1.0f, peak.max) * middle;
+            const float bottom = middle - juce::jlimit(-1.0f, 1.0f, peak.min) * middle;
+
+            g.drawVerticalLine(width - shift + i, top, juce::jmax(bottom, top + 1.0f));
+        }
+    }
+
+    juce::Image trace;
+    AnalyserFeed::Peak column { 0.0f, 0.0f };
+    int columnCount = 0;
+    std::vector<AnalyserFeed::Peak> newColumns;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ScopeView)
+};
+
+//==============================================================================
+/*
+    The voice's spectrum on a log frequency axis, from minDecibels to 0 dBFS.
+
+    Each frame from the feed is Hann-windowed and transformed once; levels
+    fall back by decayPerFrame rather than jumping, and the path is only
+    rebuilt when a frame arrives.
+*/
+class SpectrumView : public juce::Component
+{
+public:
+    static constexpr float minDecibels = -100.0f;
+    static constexpr float decayPerFrame = 3.0f;
+    static constexpr float lowestFrequency = 20.0f;
+
+    SpectrumView()
+        : fft(AnalyserFeed::fftOrder),
+          window(static_cast<size_t>(AnalyserFeed::fftSize), juce::dsp::WindowingFunction<float>::hann, false)
+    {
+        setInterceptsMouseClicks(false, false);
+        levels.fill(minDecibels);
+    }
+
+    /** Message thread: fftSize consecutive samples at sampleRate. */
+    void addFrame(const float* samples, double sampleRate)
+    {
+        std::copy_n(samples, AnalyserFeed::fftSize, fftData.begin());
+        window.multiplyWithWindowingTable(fftData.data(), static_cast<size_t>(AnalyserFeed::fftSize));
+        fft.performFrequencyOnlyForwardTransform(fftData.data(), true);
+
+        // One-sided, and the Hann window halves a sine, so a full-scale sine reads 0 dB
+        const float scale = 4.0f / static_cast<float>(AnalyserFeed::fftSize);
+
+        for (size_t bin = 0; bin < levels.size(); ++bin)
+            levels[bin] = juce::jmax(juce::Decibels::gainToDecibels(fftData[bin] * scale, minDecibels), levels[bin] - decayPerFrame);
+
+        nyquist = static_cast<float>(sampleRate * 0.5);
+        updatePath();
+        repaint();
+    }
+
+    void paint(juce::Graphics& g) override
+    {
+        g.fillAll(juce::Colours::black.withAlpha(0.5f));
+        g.setColour(juce::Colours::white);
+        g.strokePath(spectrum, juce::PathStrokeType(1.0f));
+    }
+
+    void resized() override
+    {
+        updatePath();
+    }
+
+private:
+    // Each pixel column shows the loudest bin it covers
+    void updatePath()
+    {
+        spectrum.clear();
+
+        const int width = getWidth();
+        const float height = static_cast<float>(getHeight());
+        const float binsPerHz = static_cast<float>(AnalyserFeed::fftSize) / (2.0f * nyquist);
+        const float octaves = std::log2(nyquist / lowestFrequency);
+
+        for (int x = 0; x < width; ++x)
+        {
+            const float low = lowestFrequency * std::exp2(octaves * static_cast<float>(x) / static_cast<float>(width));
+            const float high = lowestFrequency * std::exp2(octaves * static_cast<float>(x + 1) / static_cast<float>(width));
+            const int firstBin = juce::jlimit(1, numBins - 1, static_cast<int>(low * binsPerHz));
+            const int lastBin = juce::jlimit(firstBin, numBins - 1, static_cast<int>(high * binsPerHz));
+
+            const float level = *std::max_element(levels.begin() + firstBin, levels.begin() + lastBin + 1);
+            const float y = juce::jmap(level, minDecibels, 0.0f, height, 0.0f);
+
+            if (x == 0)
+                spectrum.startNewSubPath(0.0f, y);
+            else
+                spectrum.lineTo(static_cast<float>(x), y);
+        }
+    }
+
+    static constexpr int numBins = AnalyserFeed::fftSize / 2 + 1;
+
+    juce::dsp::FFT fft;
+    juce::dsp::WindowingFunction<float> window;
+    std::array<float, 2 * AnalyserFeed::fftSize> fftData;
+    std::array<float, numBins> levels;
+    float nyquist = 22050.0f;
+    juce::Path spectrum;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SpectrumView)
+};
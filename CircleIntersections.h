@@ -0,0 +1,100 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "DSPKernels.h"
+
+//==============================================================================
+/*
+    A frame's worth of candidate circle pairs, tested together.
+
+    Fill it with addPair() after clear(), then solve(). The pairs are kept as
+    separate coordinate arrays so DSPKernels::findIntersectingPairs can test
+    several per instruction on squared distances. Crossing points are then
+    worked out only for the pairs that hit. Storage grows to the busiest frame
+    seen and is reused after that, so steady frames don't allocate.
+*/
+class CircleIntersectionBatch
+{
+public:
+    struct Intersection
+    {
+        float x1, y1;   // the two crossing points; equal when the circles touch
+        float x2, y2;
+        float r1, r2;   // the radii the pair was added with, no lower than 0
+        int pair;       // the order in which the pair was added
+    };
+
+    void clear() noexcept { numPairs = 0; }
+
+    void addPair(float x1, float y1, float r1, float x2, float y2, float r2)
+    {
+        if (numPairs == static_cast<int>(hits.size()))
+            grow(juce::jmax(64, numPairs * 2));
+
+        const auto i = static_cast<size_t>(numPairs++);
+        columns[0][i] = x1;
+        columns[1][i] = y1;
+        columns[2][i] = r1;
+        columns[3][i] = x2;
+        columns[4][i] = y2;
+        columns[5][i] = r2;
+    }
+
+    int getNumPairs() const noexcept { return numPairs; }
+
+    /** Finds the crossing points of every pair added since clear(). Pairs
+        with the same centre either coincide or never meet, so they're skipped.
+    */
+    const std::vector<Intersection>& solve(const DSPKernels& kernels)
+    {
+        const CirclePairs pairs { columns[0].data(), columns[1].data(), columns[2].data(),
+                                  columns[3].data(), columns[4].data(), columns[5].data() };
+
+        const int numHits = kernels.findIntersectingPairs(pairs, numPairs, hits.data());
+
+        intersections.clear();
+
+        for (int hit = 0; hit < numHits; ++hit)
+        {
+            const int i = hits[static_cast<size_t>(hit)];
+            const float dx = pairs.x2[i] - pairs.x1[i];
+            const float dy = pairs.y2[i] - pairs.y1[i];
+            const float distanceSquared = dx * dx + dy * dy;
+
+            if (distanceSquared <= 0.0f)
+                continue;
+
+            const float r1 = juce::jmax(pairs.r1[i], 0.0f);
+            const float r2 = juce::jmax(pairs.r2[i], 0.0f);
+
+            // a: how far along the centre line the chord sits; h: half the chord
+            const float inverseDistance = 1.0f / std::sqrt(distanceSquared);
+            const float a = (r1 * r1 - r2 * r2 + distanceSquared) * 0.5f * inverseDistance;
+            const float h = std::sqrt(juce::jmax(r1 * r1 - a * a, 0.0f));
+
+            const float ux = dx * inverseDistance;
+            const float uy = dy * inverseDistance;
+            const float cx = pairs.x1[i] + a * ux;
+            const float cy = pairs.y1[i] + a * uy;
+
+            intersections.push_back({ cx + h * uy, cy - h * ux, cx - h * uy, cy + h * ux, r1, r2, i });
+        }
+
+        return intersections;
+    }
+
+private:
+    void grow(int capacity)
+    {
+        for (auto& column : columns)
+            column.resize(static_cast<size_t>(capacity));
+
+        hits.resize(static_cast<size_t>(capacity));
+        intersections.reserve(static_cast<size_t>(capacity));
+    }
+
+    std::array<std::vector<float>, 6> columns;  // x1, y1, r1, x2, y2, r2
+    std::vector<int> hits;
+    std::vector<Intersection> intersections;
+    int numPairs = 0;
+};
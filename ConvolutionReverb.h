@@ -0,0 +1,555 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "HazardPointer.h"
+
+//==============================================================================
+/*
+    An impulse response cut up for ConvolutionReverb at one sample rate.
+
+    The first partitionSize samples are the head, kept in the time domain and
+    convolved directly, so the reverb adds no latency. The rest is the tail:
+    partitionSize blocks, each zero-padded to fftSize and transformed once
+    here. Spectra are stored planar, all real parts then all imaginary parts,
+    so the multiply-accumulate in the reverb vectorises.
+
+    Building one allocates and runs an FFT per partition. Do it off the audio
+    thread, then treat it as immutable.
+*/
+class PartitionedImpulseResponse
+{
+public:
+    static constexpr int fftOrder = 9;
+    static constexpr int fftSize = 1 << fftOrder;
+    static constexpr int partitionSize = fftSize / 2;
+    static constexpr int numBins = fftSize / 2 + 1;
+    static constexpr double maximumSeconds = 4.0;   // longer responses are cut short
+
+    static int getMaximumTailPartitions(double sampleRate) noexcept
+    {
+        return juce::jmax(0, static_cast<int>(std::ceil(maximumSeconds * sampleRate / partitionSize)) - 1);
+    }
+
+    /** samples are at sourceSampleRate and get resampled to sampleRate. The
+        result is scaled to unit energy, so every response sits at about the
+        level of the dry signal.
+    */
+    PartitionedImpulseResponse(const float* samples, int numSamples, double sourceSampleRate, double sampleRate)
+        : rate(sampleRate)
+    {
+        const double ratio = sourceSampleRate / sampleRate;
+        const int length = juce::jlimit(1, (getMaximumTailPartitions(sampleRate) + 1) * partitionSize,
+                                        static_cast<int>(numSamples / ratio));
+
+        std::vector<float> response(static_cast<size_t>(length));
+
+        for (int i = 0; i < length; ++i)
+        {
+            const double position = i * ratio;
+            const int index = static_cast<int>(position);
+            const float fraction = static_cast<float>(position - index);
+            const float a = samples[juce::jmin(index, numSamples - 1)];
+            const float b = samples[juce::jmin(index + 1, numSamples - 1)];
+            response[static_cast<size_t>(i)] = a + fraction * (b - a);
+        }
+
+        double energy = 0.0;
+
+        for (auto sample : response)
+            energy += static_cast<double>(sample) * sample;
+
+        if (energy > 0.0)
+            juce::FloatVectorOperations::multiply(response.data(), static_cast<float>(1.0 / std::sqrt(energy)), length);
+
+        head.assign(static_cast<size_t>(partitionSize), 0.0f);
+        std::copy(response.begin(), response.begin() + juce::jmin(length, partitionSize), head.begin());
+
+        numTailPartitions = (length - 1) / partitionSize;
+        tail.assign(static_cast<size_t>(numTailPartitions * 2 * numBins), 0.0f);
+
+        juce::dsp::FFT fft(fftOrder);
+        std::vector<float> data(2 * fftSize);
+
+        for (int partition = 0; partition < numTailPartitions; ++partition)
+        {
+            const int start = (partition + 1) * partitionSize;
+            const int count = juce::jmin(partitionSize, length - start);
+
+            std::fill(data.begin(), data.end(), 0.0f);
+            std::copy(response.begin() + start, response.begin() + start + count, data.begin());
+
+            fft.performRealOnlyForwardTransform(data.data(), true);
+
+            auto* spectrum = tail.data() + partition * 2 * numBins;
+
+            for (int bin = 0; bin < numBins; ++bin)
+            {
+                spectrum[bin] = data[static_cast<size_t>(2 * bin)];
+                spectrum[numBins + bin] = data[static_cast<size_t>(2 * bin + 1)];
+            }
+        }
+    }
+
+    double getSampleRate() const noexcept                           { return rate; }
+    int getNumTailPartitions() const noexcept                       { return numTailPartitions; }
+
+    /** partitionSize samples, the first of them at time 0. */
+    const float* getHead() const noexcept                           { return head.data(); }
+
+    /** numBins real parts followed by numBins imaginary parts. */
+    const float* getTailPartition(int index) const noexcept         { return tail.data() + index * 2 * numBins; }
+
+private:
+    double rate;
+    std::vector<float> head;
+    std::vector<float> tail;
+    int numTailPartitions = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PartitionedImpulseResponse)
+};
+
+//==============================================================================
+/*
+    Mono uniformly partitioned convolution, overlap-save.
+
+    The head is a direct-form FIR over the samples as they arrive, so output
+    never waits for a full partition. Each time a partition of input is
+    complete, its spectrum goes into a frequency-domain delay line, and every
+    tail partition is multiplied against the matching older spectrum. One
+    inverse FFT of the sum gives the tail for the next partition. The tail
+    starts one partition in, so it is always ready in time.
+
+    The delay line holds input spectra, not the response, so the response can
+    change between calls without resetting. Everything apart from prepare()
+    belongs to the audio thread.
+*/
+class ConvolutionReverb
+{
+public:
+    static constexpr int partitionSize = PartitionedImpulseResponse::partitionSize;
+    static constexpr int numBins = PartitionedImpulseResponse::numBins;
+
+    void prepare(double sampleRate)
+    {
+        maxTailPartitions = juce::jmax(1, PartitionedImpulseResponse::getMaximumTailPartitions(sampleRate));
+
+        input.assign(2 * partitionSize, 0.0f);
+        tailOutput.assign(partitionSize, 0.0f);
+        fftData.assign(2 * PartitionedImpulseResponse::fftSize, 0.0f);
+        accumulator.assign(2 * numBins, 0.0f);
+        spectra.assign(static_cast<size_t>(maxTailPartitions * 2 * numBins), 0.0f);
+
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        std::fill(input.begin(), input.end(), 0.0f);
+        std::fill(tailOutput.begin(), tailOutput.end(), 0.0f);
+        std::fill(spectra.begin(), spectra.end(), 0.0f);
+        inputPosition = 0;
+        newestSpectrum = 0;
+    }
+
+    /** Writes the wet signal only. output may be the same buffer as source. */
+    void process(const float* source, float* output, int numSamples, const PartitionedImpulseResponse& response) noexcept
+    {
+        while (numSamples > 0)
+        {
+            const int count = juce::jmin(numSamples, partitionSize - inputPosition);
+
+            // input holds the previous partition then the current one, so the
+            // head can look back partitionSize - 1 samples from any new sample
+            auto* newest = input.data() + partitionSize + inputPosition;
+            juce::FloatVectorOperations::copy(newest, source, count);
+            juce::FloatVectorOperations::copy(output, tailOutput.data() + inputPosition, count);
+
+            const auto* head = response.getHead();
+
+            for (int tap = 0; tap < partitionSize; ++tap)
+                if (head[tap] != 0.0f)
+                    juce::FloatVectorOperations::addWithMultiply(output, newest - tap, head[tap], count);
+
+            inputPosition += count;
+            source += count;
+            output += count;
+            numSamples -= count;
+
+            if (inputPosition == partitionSize)
+            {
+                renderTail(response);
+                inputPosition = 0;
+            }
+        }
+    }
+
+private:
+    void renderTail(const PartitionedImpulseResponse& response) noexcept
+    {
+        newestSpectrum = (newestSpectrum + 1) % maxTailPartitions;
+
+        std::copy(input.begin(), input.end(), fftData.begin());
+        fft.performRealOnlyForwardTransform(fftData.data(), true);
+
+        auto* newest = spectra.data() + newestSpectrum * 2 * numBins;
+
+        for (int bin = 0; bin < numBins; ++bin)
+        {
+            newest[bin] = fftData[static_cast<size_t>(2 * bin)];
+            newest[numBins + bin] = fftData[static_cast<size_t>(2 * bin + 1)];
+        }
+
+        std::copy(input.begin() + partitionSize, input.end(), input.begin());
+
+        // Tail partition p lies p + 1 partitions in, so it meets the input
+        // spectrum p partitions older than the one just taken
+        std::fill(accumulator.begin(), accumulator.end(), 0.0f);
+        auto* sumReal = accumulator.data();
+        auto* sumImag = accumulator.data() + numBins;
+
+        const int numPartitions = juce::jmin(response.getNumTailPartitions(), maxTailPartitions);
+
+        for (int partition = 0; partition < numPartitions; ++partition)
+        {
+            const int age = (newestSpectrum - partition + maxTailPartitions) % maxTailPartitions;
+            const auto* x = spectra.data() + age * 2 * numBins;
+            const auto* h = response.getTailPartition(partition);
+
+            for (int bin = 0; bin < numBins; ++bin)
+            {
+                sumReal[bin] += h[bin] * x[bin] - h[numBins + bin] * x[numBins + bin];
+                sumImag[bin] += h[bin] * x[numBins + bin] + h[numBins + bin] * x[bin];
+            }
+        }
+
+        for (int bin = 0; bin < numBins; ++bin)
+        {
+            fftData[static_cast<size_t>(2 * bin)] = sumReal[bin];
+            fftData[static_cast<size_t>(2 * bin + 1)] = sumImag[bin];
+        }
+
+        fft.performRealOnlyInverseTransform(fftData.data());
+
+        // Overlap-save: only the second half is free of circular wrap-around
+        std::copy(fftData.begin() + partitionSize, fftData.begin() + 2 * partitionSize, tailOutput.begin());
+    }
+
+    juce::dsp::FFT fft { PartitionedImpulseResponse::fftOrder };
+
+    std::vector<float> input, tailOutput, fftData, accumulator;
+    std::vector<float> spectra;     // the frequency-domain delay line, maxTailPartitions spectra
+    int maxTailPartitions = 1;
+    int inputPosition = 0;
+    int newestSpectrum = 0;
+};
+
+//==============================================================================
+/** Process-wide reverb response shared by every instance; hold it with juce::SharedResourcePointer.
+
+    Each instance owns a Reader. prepare() attaches it to the slot for its
+    sample rate, and release() lets go; a slot lasts while any reader is on
+    it. Responses for each slot are built on a background thread and
+    published through an atomic pointer, so the audio thread just reads
+    get().
+
+    A reader's get() also marks the response it returned as in use, and a
+    response that has been replaced or whose slot has emptied is only
+    deleted once no reader is marked as using it.
+*/
+class SharedImpulseResponse : private juce::Thread
+{
+public:
+    static constexpr int maxSampleRates = 4;
+
+    /** One instance's hold on a slot. Release it before it is destroyed. */
+    class Reader
+    {
+    public:
+        Reader() = default;
+
+    private:
+        friend class SharedImpulseResponse;
+
+        int slot = -1;
+        std::atomic<const PartitionedImpulseResponse*> inUse { nullptr };
+
+        JUCE_DECLARE_NON_COPYABLE(Reader)
+    };
+
+    SharedImpulseResponse() : juce::Thread("Tekhne impulse response")
+    {
+        sourceSampleRate = 48000.0;
+        source = createPondResponse(sourceSampleRate);
+    }
+
+    ~SharedImpulseResponse() override
+    {
+        stopThread(4000);
+
+        jassert(readers.empty()); // an instance didn't release its reader
+
+        for (auto& slot : slots)
+            delete slot.response.load();
+    }
+
+    /** Message thread, audio stopped: attaches reader to the slot for this
+        sample rate, letting go of any other. If too many rates are in use it
+        is left without one. The response may take a moment to appear.
+    */
+    void prepare(Reader& reader, double sampleRate)
+    {
+        {
+            const juce::ScopedLock sl(lock);
+
+            if (reader.slot >= 0 && slots[static_cast<size_t>(reader.slot)].sampleRate == sampleRate)
+                return;
+
+            detach(reader);
+
+            for (int i = 0; i < maxSampleRates && reader.slot < 0; ++i)
+                if (slots[static_cast<size_t>(i)].sampleRate == sampleRate)
+                    reader.slot = i;
+
+            for (int i = 0; i < maxSampleRates && reader.slot < 0; ++i)
+                if (slots[static_cast<size_t>(i)].users == 0)
+                    slots[static_cast<size_t>(reader.slot = i)].sampleRate = sampleRate;
+
+            jassert(reader.slot >= 0); // instances are running at more sample rates than there are slots
+
+            if (reader.slot >= 0)
+            {
+                ++slots[static_cast<size_t>(reader.slot)].users;
+                readers.push_back(&reader);
+            }
+        }
+
+        startBuilding();
+    }
+
+    /** Message thread, audio stopped: lets go of reader's slot, if it has one. */
+    void release(Reader& reader)
+    {
+        const juce::ScopedLock sl(lock);
+        detach(reader);
+        collectRetired();
+    }
+
+    /** Any non-audio thread: replaces the response for every instance. The file
+        is read in the background; if it can't be decoded the old response stays.
+    */
+    juce::Result load(const juce::File& file)
+    {
+        if (! file.existsAsFile())
+            return juce::Result::fail("Impulse response not found: " + file.getFullPathName());
+
+        {
+            const juce::ScopedLock sl(lock);
+            pendingFile = file;
+        }
+
+        startBuilding();
+        return juce::Result::ok();
+    }
+
+    /** Audio thread: the reader's response, nullptr until its slot's first is
+        ready. It stays valid until the reader's next get() or release().
+    */
+    const PartitionedImpulseResponse* get(Reader& reader) const noexcept
+    {
+        if (! juce::isPositiveAndBelow(reader.slot, maxSampleRates))
+            return nullptr;
+
+        return acquireHazardPointer(slots[static_cast<size_t>(reader.slot)].response, reader.inUse);
+    }
+
+private:
+    struct Slot
+    {
+        double sampleRate = 0.0;
+        int users = 0;
+        int builtVersion = -1;
+        std::atomic<const PartitionedImpulseResponse*> response { nullptr };
+    };
+
+    static constexpr int retiredPollMs = 100;
+
+    // Called with the lock held
+    void detach(Reader& reader)
+    {
+        if (reader.slot < 0)
+            return;
+
+        auto& slot = slots[static_cast<size_t>(reader.slot)];
+
+        if (--slot.users == 0)
+        {
+            slot.sampleRate = 0.0;
+            slot.builtVersion = -1;
+            retire(slot.response.exchange(nullptr));
+        }
+
+        readers.erase(std::remove(readers.begin(), readers.end(), &reader), readers.end());
+        reader.inUse.store(nullptr);
+        reader.slot = -1;
+    }
+
+    // Called with the lock held
+    void retire(const PartitionedImpulseResponse* response)
+    {
+        if (response != nullptr)
+            retired.emplace_back(response);
+    }
+
+    // Called with the lock held: deletes the retired responses no reader is using
+    void collectRetired()
+    {
+        auto isInUse = [this](const std::unique_ptr<const PartitionedImpulseResponse>& response)
+        {
+            return std::any_of(readers.begin(), readers.end(),
+                               [&response](const Reader* r) { return r->inUse.load() == response.get(); });
+        };
+
+        retired.erase(std::remove_if(retired.begin(), retired.end(), [&isInUse](const auto& r) { return ! isInUse(r); }),
+                      retired.end());
+    }
+
+    void startBuilding()
+    {
+        if (! isThreadRunning())
+            startThread();
+
+        notify();
+    }
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            readPendingFile();
+
+            std::vector<float> samples;
+            double samplesRate = 0.0, sampleRate = 0.0;
+            int version = 0, slot = -1;
+            bool waitingToRetire = false;
+
+            {
+                const juce::ScopedLock sl(lock);
+
+                collectRetired();
+                waitingToRetire = ! retired.empty();
+
+                for (int i = 0; i < maxSampleRates && slot < 0; ++i)
+                {
+                    const auto& candidate = slots[static_cast<size_t>(i)];
+
+                    if (candidate.users > 0 && candidate.builtVersion != sourceVersion)
+                    {
+                        slot = i;
+                        sampleRate = candidate.sampleRate;
+                        samples = source;
+                        samplesRate = sourceSampleRate;
+                        version = sourceVersion;
+                    }
+                }
+            }
+
+            if (slot < 0)
+            {
+                // Readers move off a replaced response at their next block
+                wait(waitingToRetire ? retiredPollMs : -1);
+                continue;
+            }
+
+            auto response = std::make_unique<PartitionedImpulseResponse>(samples.data(), static_cast<int>(samples.size()),
+                                                                         samplesRate, sampleRate);
+
+            const juce::ScopedLock sl(lock);
+            auto& target = slots[static_cast<size_t>(slot)];
+
+            // Let go of, or handed to another rate, while it was being built
+            if (target.users == 0 || target.sampleRate != sampleRate)
+                continue;
+
+            retire(target.response.exchange(response.release()));
+            target.builtVersion = version;
+        }
+    }
+
+    void readPendingFile()
+    {
+        juce::File file;
+
+        {
+            const juce::ScopedLock sl(lock);
+            std::swap(file, pendingFile);
+        }
+
+        if (file == juce::File())
+            return;
+
+        juce::AudioFormatManager formats;
+        formats.registerBasicFormats();
+        std::unique_ptr<juce::AudioFormatReader> reader(formats.createReaderFor(file));
+
+        if (reader == nullptr || reader->lengthInSamples <= 0 || reader->sampleRate <= 0.0)
+            return;
+
+        const int length = static_cast<int>(juce::jmin(reader->lengthInSamples,
+                                                       static_cast<juce::int64>(PartitionedImpulseResponse::maximumSeconds * reader->sampleRate)));
+        const int numChannels = static_cast<int>(reader->numChannels);
+
+        juce::AudioBuffer<float> buffer(numChannels, length);
+        reader->read(&buffer, 0, length, 0, true, true);
+
+        // The voice is mono before it is panned, so the channels are summed
+        std::vector<float> samples(static_cast<size_t>(length), 0.0f);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            juce::FloatVectorOperations::add(samples.data(), buffer.getReadPointer(channel), length);
+
+        const juce::ScopedLock sl(lock);
+        source = std::move(samples);
+        sourceSampleRate = reader->sampleRate;
+        ++sourceVersion;
+    }
+
+    // The built-in "pond": a few early reflections off the banks, then a
+    // dense tail that loses its top end as it dies away
+    static std::vector<float> createPondResponse(double sampleRate)
+    {
+        const double decaySeconds = 2.2;    // to -60 dB
+        const int length = static_cast<int>(2.5 * sampleRate);
+        std::vector<float> samples(static_cast<size_t>(length));
+
+        juce::Random random(0x70d);
+        float smoothed = 0.0f;
+
+        for (int i = 0; i < length; ++i)
+        {
+            const double time = i / sampleRate;
+            const float damping = 0.2f + 0.75f * static_cast<float>(time / 2.5);
+            const float noise = random.nextFloat() * 2.0f - 1.0f;
+
+            smoothed += (1.0f - damping) * (noise - smoothed);
+            samples[static_cast<size_t>(i)] = smoothed * static_cast<float>(std::pow(0.001, time / decaySeconds));
+        }
+
+        static constexpr std::array<std::pair<double, float>, 5> reflections { { { 0.011, 0.7f }, { 0.017, -0.5f }, { 0.023, 0.4f },
+                                                                                 { 0.031, -0.3f }, { 0.043, 0.25f } } };
+
+        for (const auto& [time, level] : reflections)
+            samples[static_cast<size_t>(time * sampleRate)] += level;
+
+        return samples;
+    }
+
+    juce::CriticalSection lock;
+    std::vector<float> source;
+    double sourceSampleRate = 0.0;
+    int sourceVersion = 0;
+    juce::File pendingFile;
+
+    std::array<Slot, maxSampleRates> slots;
+    std::vector<Reader*> readers;
+    std::vector<std::unique_ptr<const PartitionedImpulseResponse>> retired;
+};
@@ -0,0 +1,637 @@
+#include "DSPKernels.h"
+#include "SharedDSPTables.h"
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+
+ // MSVC lets any function use any intrinsic; GCC and Clang need each
+ // function tagged with the instruction set it was written for.
+ #if JUCE_MSVC
+  #define TEKHNE_TARGET(isa)
+ #else
+  #define TEKHNE_TARGET(isa) __attribute__((target(isa)))
+ #endif
+#endif
+
+namespace
+{
+    constexpr int sineMask = SharedDSPTables::sineTableSize - 1;
+    constexpr float radiansToIndex = static_cast<float>(SharedDSPTables::radiansToIndex);
+
+    std::atomic<KernelLevel> maximumLevel { KernelLevel::avx512 };
+
+    //==============================================================================
+    inline float lookupSine(const float* table, float phase) noexcept
+    {
+        const float position = phase * radiansToIndex;
+        const int index = static_cast<int>(position);
+        const float fraction = position - static_cast<float>(index);
+        const auto* entry = table + (index & sineMask);
+
+        return entry[0] + fraction * (entry[1] - entry[0]);
+    }
+
+    void addModulatorScalar(float* modulatedFreq, const float* ramp, const float* phases, const float* table, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i)
+            modulatedFreq[i] += ramp[i] * lookupSine(table, phases[i]);
+    }
+
+    void renderSineScalar(float* output, const float* phases, float gain, const float* table, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i)
+            output[i] = lookupSine(table, phases[i]) * gain;
+    }
+
+    // Starts at sample 'done', so vector loops can hand over their tail on the same gain line
+    void copyWithGainRampTail(float* output, const float* source, float startGain, float endGain, int done, int numSamples)
+    {
+        const float step = (endGain - startGain) / static_cast<float>(numSamples);
+
+        for (int i = done; i < numSamples; ++i)
+            output[i] = source[i] * (startGain + step * static_cast<float>(i));
+    }
+
+    void copyWithGainRampScalar(float* output, const float* source, float startGain, float endGain, int numSamples)
+    {
+        copyWithGainRampTail(output, source, startGain, endGain, 0, numSamples);
+    }
+
+    // Squared distances only: the circles meet when |r1 - r2| <= d <= r1 + r2
+    int findIntersectingPairsTail(const CirclePairs& pairs, int start, int numPairs, int* hits, int numHits)
+    {
+        for (int i = start; i < numPairs; ++i)
+        {
+            const float dx = pairs.x2[i] - pairs.x1[i];
+            const float dy = pairs.y2[i] - pairs.y1[i];
+            const float r1 = std::max(pairs.r1[i], 0.0f);
+            const float r2 = std::max(pairs.r2[i], 0.0f);
+            const float distanceSquared = dx * dx + dy * dy;
+
+            if (distanceSquared <= (r1 + r2) * (r1 + r2) && distanceSquared >= (r1 - r2) * (r1 - r2))
+                hits[numHits++] = i;
+        }
+
+        return numHits;
+    }
+
+    int findIntersectingPairsScalar(const CirclePairs& pairs, int numPairs, int* hits)
+    {
+        return findIntersectingPairsTail(pairs, 0, numPairs, hits, 0);
+    }
+
+    // Starts at cell 'done', like copyWithGainRampTail
+    void stepWaveRowTail(float* previous, const float* up, const float* centre, const float* down,
+                         float courant, float damping, int done, int numCells)
+    {
+        const float centreWeight = 2.0f - 4.0f * courant;
+
+        for (int i = done; i < numCells; ++i)
+        {
+            const float neighbours = (up[i] + down[i]) + (centre[i - 1] + centre[i + 1]);
+            previous[i] = damping * (centreWeight * centre[i] + courant * neighbours - previous[i]);
+        }
+    }
+
+    void stepWaveRowScalar(float* previous, const float* up, const float* centre, const float* down,
+                           float courant, float damping, int numCells)
+    {
+        stepWaveRowTail(previous, up, centre, down, courant, damping, 0, numCells);
+    }
+
+    // Starts at sample 'done'. Positions are worked out from the start of the
+    // run, not accumulated, so every version lands on the same values.
+    void addFMGrainTail(float* output, const FMGrain& grain, const float* table, int done, int numSamples)
+    {
+        for (int i = done; i < numSamples; ++i)
+        {
+            const float position = static_cast<float>(i);
+            const float envelope = grain.envelopePosition + grain.envelopeIncrement * position;
+            const float modulator = lookupSine(table, grain.modulatorPhase + grain.modulatorIncrement * position);
+            const float carrier = lookupSine(table, grain.carrierPhase + grain.carrierIncrement * position + grain.modulationIndex * modulator);
+
+            output[i] += (grain.gain * 4.0f) * (envelope * (1.0f - envelope)) * carrier;
+        }
+    }
+
+    void addFMGrainScalar(float* output, const FMGrain& grain, const float* table, int numSamples)
+    {
+        addFMGrainTail(output, grain, table, 0, numSamples);
+    }
+
+    // Appends start + lane for every set bit of mask without branching: each
+    // lane is written, but only hits move the end on. The end never passes
+    // start + lane, so nothing is written beyond the pair being tested.
+    template <int numLanes>
+    inline int appendHits(unsigned mask, int start, int* hits, int numHits) noexcept
+    {
+        for (int lane = 0; lane < numLanes; ++lane)
+        {
+            hits[numHits] = start + lane;
+            numHits += static_cast<int>((mask >> lane) & 1u);
+        }
+
+        return numHits;
+    }
+
+   #if JUCE_INTEL
+    //==============================================================================
+    // SSE2 has no gather, so the two table reads go through the stack.
+    TEKHNE_TARGET("sse2") inline __m128 lookupSineSSE2(const float* table, __m128 phase) noexcept
+    {
+        const __m128 position = _mm_mul_ps(phase, _mm_set1_ps(radiansToIndex));
+        const __m128i index = _mm_cvttps_epi32(position);
+        const __m128 fraction = _mm_sub_ps(position, _mm_cvtepi32_ps(index));
+
+        alignas(16) int lanes[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), _mm_and_si128(index, _mm_set1_epi32(sineMask)));
+
+        const __m128 a = _mm_setr_ps(table[lanes[0]],     table[lanes[1]],     table[lanes[2]],     table[lanes[3]]);
+        const __m128 b = _mm_setr_ps(table[lanes[0] + 1], table[lanes[1] + 1], table[lanes[2] + 1], table[lanes[3] + 1]);
+
+        return _mm_add_ps(a, _mm_mul_ps(fraction, _mm_sub_ps(b, a)));
+    }
+
+    TEKHNE_TARGET("sse2") void addModulatorSSE2(float* modulatedFreq, const float* ramp, const float* phases, const float* table, int numSamples)
+    {
+        int i = 0;
+
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            const __m128 sine = lookupSineSSE2(table, _mm_loadu_ps(phases + i));
+            _mm_storeu_ps(modulatedFreq + i, _mm_add_ps(_mm_loadu_ps(modulatedFreq + i), _mm_mul_ps(_mm_loadu_ps(ramp + i), sine)));
+        }
+
+        addModulatorScalar(modulatedFreq + i, ramp + i, phases + i, table, numSamples - i);
+    }
+
+    TEKHNE_TARGET("sse2") void renderSineSSE2(float* output, const float* phases, float gain, const float* table, int numSamples)
+    {
+        const __m128 gains = _mm_set1_ps(gain);
+        int i = 0;
+
+        for (; i + 4 <= numSamples; i += 4)
+            _mm_storeu_ps(output + i, _mm_mul_ps(lookupSineSSE2(table, _mm_loadu_ps(phases + i)), gains));
+
+        renderSineScalar(output + i, phases + i, gain, table, numSamples - i);
+    }
+
+    TEKHNE_TARGET("sse2") void copyWithGainRampSSE2(float* output, const float* source, float startGain, float endGain, int numSamples)
+    {
+        const float step = (endGain - startGain) / static_cast<float>(numSamples);
+        const __m128 steps = _mm_set1_ps(step);
+        __m128 positions = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+        int i = 0;
+
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            const __m128 gains = _mm_add_ps(_mm_set1_ps(startGain), _mm_mul_ps(steps, positions));
+            _mm_storeu_ps(output + i, _mm_mul_ps(_mm_loadu_ps(source + i), gains));
+            positions = _mm_add_ps(positions, _mm_set1_ps(4.0f));
+        }
+
+        copyWithGainRampTail(output, source, startGain, endGain, i, numSamples);
+    }
+
+    TEKHNE_TARGET("sse2") int findIntersectingPairsSSE2(const CirclePairs& pairs, int numPairs, int* hits)
+    {
+        const __m128 zero = _mm_setzero_ps();
+        int numHits = 0;
+        int i = 0;
+
+        for (; i + 4 <= numPairs; i += 4)
+        {
+            const __m128 dx = _mm_sub_ps(_mm_loadu_ps(pairs.x2 + i), _mm_loadu_ps(pairs.x1 + i));
+            const __m128 dy = _mm_sub_ps(_mm_loadu_ps(pairs.y2 + i), _mm_loadu_ps(pairs.y1 + i));
+            const __m128 r1 = _mm_max_ps(_mm_loadu_ps(pairs.r1 + i), zero);
+            const __m128 r2 = _mm_max_ps(_mm_loadu_ps(pairs.r2 + i), zero);
+            const __m128 distanceSquared = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+            const __m128 sum = _mm_add_ps(r1, r2);
+            const __m128 difference = _mm_sub_ps(r1, r2);
+
+            const __m128 hit = _mm_and_ps(_mm_cmple_ps(distanceSquared, _mm_mul_ps(sum, sum)),
+                                          _mm_cmpge_ps(distanceSquared, _mm_mul_ps(difference, difference)));
+
+            numHits = appendHits<4>(static_cast<unsigned>(_mm_movemask_ps(hit)), i, hits, numHits);
+        }
+
+        return findIntersectingPairsTail(pairs, i, numPairs, hits, numHits);
+    }
+
+    TEKHNE_TARGET("sse2") void stepWaveRowSSE2(float* previous, const float* up, const float* centre, const float* down,
+                                               float courant, float damping, int numCells)
+    {
+        const __m128 centreWeight = _mm_set1_ps(2.0f - 4.0f * courant);
+        const __m128 courants = _mm_set1_ps(courant);
+        const __m128 dampings = _mm_set1_ps(damping);
+        int i = 0;
+
+        for (; i + 4 <= numCells; i += 4)
+        {
+            const __m128 neighbours = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(up + i), _mm_loadu_ps(down + i)),
+                                                 _mm_add_ps(_mm_loadu_ps(centre + i - 1), _mm_loadu_ps(centre + i + 1)));
+            const __m128 next = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(centreWeight, _mm_loadu_ps(centre + i)), _mm_mul_ps(courants, neighbours)),
+                                           _mm_loadu_ps(previous + i));
+            _mm_storeu_ps(previous + i, _mm_mul_ps(dampings, next));
+        }
+
+        stepWaveRowTail(previous, up, centre, down, courant, damping, i, numCells);
+    }
+
+    TEKHNE_TARGET("sse2") void addFMGrainSSE2(float* output, const FMGrain& grain, const float* table, int numSamples)
+    {
+        const __m128 envelopeStart = _mm_set1_ps(grain.envelopePosition);
+        const __m128 envelopeStep = _mm_set1_ps(grain.envelopeIncrement);
+        const __m128 carrierStart = _mm_set1_ps(grain.carrierPhase);
+        const __m128 carrierStep = _mm_set1_ps(grain.carrierIncrement);
+        const __m128 modulatorStart = _mm_set1_ps(grain.modulatorPhase);
+        const __m128 modulatorStep = _mm_set1_ps(grain.modulatorIncrement);
+        const __m128 index = _mm_set1_ps(grain.modulationIndex);
+        const __m128 gain = _mm_mul_ps(_mm_set1_ps(grain.gain), _mm_set1_ps(4.0f));
+        __m128 positions = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+        int i = 0;
+
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            const __m128 envelope = _mm_add_ps(envelopeStart, _mm_mul_ps(envelopeStep, positions));
+            const __m128 modulator = lookupSineSSE2(table, _mm_add_ps(modulatorStart, _mm_mul_ps(modulatorStep, positions)));
+            const __m128 phase = _mm_add_ps(_mm_add_ps(carrierStart, _mm_mul_ps(carrierStep, positions)),
+                                            _mm_mul_ps(index, modulator));
+            const __m128 shape = _mm_mul_ps(envelope, _mm_sub_ps(_mm_set1_ps(1.0f), envelope));
+
+            _mm_storeu_ps(output + i, _mm_add_ps(_mm_loadu_ps(output + i), _mm_mul_ps(_mm_mul_ps(gain, shape), lookupSineSSE2(table, phase))));
+            positions = _mm_add_ps(positions, _mm_set1_ps(4.0f));
+        }
+
+        addFMGrainTail(output, grain, table, i, numSamples);
+    }
+
+    //==============================================================================
+    TEKHNE_TARGET("avx2") inline __m256 lookupSineAVX2(const float* table, __m256 phase) noexcept
+    {
+        const __m256 position = _mm256_mul_ps(phase, _mm256_set1_ps(radiansToIndex));
+        const __m256i index = _mm256_cvttps_epi32(position);
+        const __m256 fraction = _mm256_sub_ps(position, _mm256_cvtepi32_ps(index));
+        const __m256i wrapped = _mm256_and_si256(index, _mm256_set1_epi32(sineMask));
+
+        const __m256 a = _mm256_i32gather_ps(table, wrapped, 4);
+        const __m256 b = _mm256_i32gather_ps(table + 1, wrapped, 4);
+
+        return _mm256_add_ps(a, _mm256_mul_ps(fraction, _mm256_sub_ps(b, a)));
+    }
+
+    TEKHNE_TARGET("avx2") void addModulatorAVX2(float* modulatedFreq, const float* ramp, const float* phases, const float* table, int numSamples)
+    {
+        int i = 0;
+
+        for (; i + 8 <= numSamples; i += 8)
+        {
+            const __m256 sine = lookupSineAVX2(table, _mm256_loadu_ps(phases + i));
+            _mm256_storeu_ps(modulatedFreq + i, _mm256_add_ps(_mm256_loadu_ps(modulatedFreq + i), _mm256_mul_ps(_mm256_loadu_ps(ramp + i), sine)));
+        }
+
+        addModulatorScalar(modulatedFreq + i, ramp + i, phases + i, table, numSamples - i);
+    }
+
+    TEKHNE_TARGET("avx2") void renderSineAVX2(float* output, const float* phases, float gain, const float* table, int numSamples)
+    {
+        const __m256 gains = _mm256_set1_ps(gain);
+        int i = 0;
+
+        for (; i + 8 <= numSamples; i += 8)
+            _mm256_storeu_ps(output + i, _mm256_mul_ps(lookupSineAVX2(table, _mm256_loadu_ps(phases + i)), gains));
+
+        renderSineScalar(output + i, phases + i, gain, table, numSamples - i);
+    }
+
+    TEKHNE_TARGET("avx2") void copyWithGainRampAVX2(float* output, const float* source, float startGain, float endGain, int numSamples)
+    {
+        const float step = (endGain - startGain) / static_cast<float>(numSamples);
+        const __m256 steps = _mm256_set1_ps(step);
+        __m256 positions = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+        int i = 0;
+
+        for (; i + 8 <= numSamples; i += 8)
+        {
+            const __m256 gains = _mm256_add_ps(_mm256_set1_ps(startGain), _mm256_mul_ps(steps, positions));
+            _mm256_storeu_ps(output + i, _mm256_mul_ps(_mm256_loadu_ps(source + i), gains));
+            positions = _mm256_add_ps(positions, _mm256_set1_ps(8.0f));
+        }
+
+        copyWithGainRampTail(output, source, startGain, endGain, i, numSamples);
+    }
+
+    // For every 8-lane mask, the set lanes packed to the front, three bits each
+    const auto leftPackTable = []
+    {
+        std::array<uint32_t, 256> table {};
+
+        for (unsigned mask = 0; mask < 256; ++mask)
+            for (unsigned lane = 0, packed = 0; lane < 8; ++lane)
+                if ((mask >> lane) & 1u)
+                    table[mask] |= lane << (3 * packed++);
+
+        return table;
+    }();
+
+    TEKHNE_TARGET("avx2") int findIntersectingPairsAVX2(const CirclePairs& pairs, int numPairs, int* hits)
+    {
+        const __m256 zero = _mm256_setzero_ps();
+        int numHits = 0;
+        int i = 0;
+
+        for (; i + 8 <= numPairs; i += 8)
+        {
+            const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(pairs.x2 + i), _mm256_loadu_ps(pairs.x1 + i));
+            const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(pairs.y2 + i), _mm256_loadu_ps(pairs.y1 + i));
+            const __m256 r1 = _mm256_max_ps(_mm256_loadu_ps(pairs.r1 + i), zero);
+            const __m256 r2 = _mm256_max_ps(_mm256_loadu_ps(pairs.r2 + i), zero);
+            const __m256 distanceSquared = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+            const __m256 sum = _mm256_add_ps(r1, r2);
+            const __m256 difference = _mm256_sub_ps(r1, r2);
+
+            const __m256 hit = _mm256_and_ps(_mm256_cmp_ps(distanceSquared, _mm256_mul_ps(sum, sum), _CMP_LE_OQ),
+                                             _mm256_cmp_ps(distanceSquared, _mm256_mul_ps(difference, difference), _CMP_GE_OQ));
+
+            // Store all 8 lanes with the hits packed to the front; numHits <= i, so the store stays below numPairs
+            const auto mask = static_cast<unsigned>(_mm256_movemask_ps(hit));
+            const __m256i lanes = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(static_cast<int>(leftPackTable[mask])),
+                                                                     _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21)),
+                                                   _mm256_set1_epi32(7));
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(hits + numHits), _mm256_add_epi32(lanes, _mm256_set1_epi32(i)));
+            numHits += juce::countNumberOfBits(mask);
+        }
+
+        return findIntersectingPairsTail(pairs, i, numPairs, hits, numHits);
+    }
+
+    TEKHNE_TARGET("avx2") void stepWaveRowAVX2(float* previous, const float* up, const float* centre, const float* down,
+                                               float courant, float damping, int numCells)
+    {
+        const __m256 centreWeight = _mm256_set1_ps(2.0f - 4.0f * courant);
+        const __m256 courants = _mm256_set1_ps(courant);
+        const __m256 dampings = _mm256_set1_ps(damping);
+        int i = 0;
+
+        for (; i + 8 <= numCells; i += 8)
+        {
+            const __m256 neighbours = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(up + i), _mm256_loadu_ps(down + i)),
+                                                    _mm256_add_ps(_mm256_loadu_ps(centre + i - 1), _mm256_loadu_ps(centre + i + 1)));
+            const __m256 next = _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(centreWeight, _mm256_loadu_ps(centre + i)), _mm256_mul_ps(courants, neighbours)),
+                                              _mm256_loadu_ps(previous + i));
+            _mm256_storeu_ps(previous + i, _mm256_mul_ps(dampings, next));
+        }
+
+        stepWaveRowTail(previous, up, centre, down, courant, damping, i, numCells);
+    }
+
+    TEKHNE_TARGET("avx2") void addFMGrainAVX2(float* output, const FMGrain& grain, const float* table, int numSamples)
+    {
+        const __m256 envelopeStart = _mm256_set1_ps(grain.envelopePosition);
+        const __m256 envelopeStep = _mm256_set1_ps(grain.envelopeIncrement);
+        const __m256 carrierStart = _mm256_set1_ps(grain.carrierPhase);
+        const __m256 carrierStep = _mm256_set1_ps(grain.carrierIncrement);
+        const __m256 modulatorStart = _mm256_set1_ps(grain.modulatorPhase);
+        const __m256 modulatorStep = _mm256_set1_ps(grain.modulatorIncrement);
+        const __m256 index = _mm256_set1_ps(grain.modulationIndex);
+        const __m256 gain = _mm256_mul_ps(_mm256_set1_ps(grain.gain), _mm256_set1_ps(4.0f));
+        __m256 positions = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+        int i = 0;
+
+        for (; i + 8 <= numSamples; i += 8)
+        {
+            const __m256 envelope = _mm256_add_ps(envelopeStart, _mm256_mul_ps(envelopeStep, positions));
+            const __m256 modulator = lookupSineAVX2(table, _mm256_add_ps(modulatorStart, _mm256_mul_ps(modulatorStep, positions)));
+            const __m256 phase = _mm256_add_ps(_mm256_add_ps(carrierStart, _mm256_mul_ps(carrierStep, positions)),
+                                               _mm256_mul_ps(index, modulator));
+            const __m256 shape = _mm256_mul_ps(envelope, _mm256_sub_ps(_mm256_set1_ps(1.0f), envelope));
+
+            _mm256_storeu_ps(output + i, _mm256_add_ps(_mm256_loadu_ps(output + i), _mm256_mul_ps(_mm256_mul_ps(gain, shape), lookupSineAVX2(table, phase))));
+            positions = _mm256_add_ps(positions, _mm256_set1_ps(8.0f));
+        }
+
+        addFMGrainTail(output, grain, table, i, numSamples);
+    }
+
+    //==============================================================================
+    TEKHNE_TARGET("avx512f") inline __m512 lookupSineAVX512(const float* table, __m512 phase) noexcept
+    {
+        const __m512 position = _mm512_mul_ps(phase, _mm512_set1_ps(radiansToIndex));
+        const __m512i index = _mm512_cvttps_epi32(position);
+        const __m512 fraction = _mm512_sub_ps(position, _mm512_cvtepi32_ps(index));
+        const __m512i wrapped = _mm512_and_si512(index, _mm512_set1_epi32(sineMask));
+
+        const __m512 a = _mm512_i32gather_ps(wrapped, table, 4);
+        const __m512 b = _mm512_i32gather_ps(wrapped, table + 1, 4);
+
+        return _mm512_add_ps(a, _mm512_mul_ps(fraction, _mm512_sub_ps(b, a)));
+    }
+
+    TEKHNE_TARGET("avx512f") void addModulatorAVX512(float* modulatedFreq, const float* ramp, const float* phases, const float* table, int numSamples)
+    {
+        int i = 0;
+
+        for (; i + 16 <= numSamples; i += 16)
+        {
+            const __m512 sine = lookupSineAVX512(table, _mm512_loadu_ps(phases + i));
+            _mm512_storeu_ps(modulatedFreq + i, _mm512_add_ps(_mm512_loadu_ps(modulatedFreq + i), _mm512_mul_ps(_mm512_loadu_ps(ramp + i), sine)));
+        }
+
+        addModulatorScalar(modulatedFreq + i, ramp + i, phases + i, table, numSamples - i);
+    }
+
+    TEKHNE_TARGET("avx512f") void renderSineAVX512(float* output, const float* phases, float gain, const float* table, int numSamples)
+    {
+        const __m512 gains = _mm512_set1_ps(gain);
+        int i = 0;
+
+        for (; i + 16 <= numSamples; i += 16)
+            _mm512_storeu_ps(output + i, _mm512_mul_ps(lookupSineAVX512(table, _mm512_loadu_ps(phases + i)), gains));
+
+        renderSineScalar(output + i, phases + i, gain, table, numSamples - i);
+    }
+
+    TEKHNE_TARGET("avx512f") void copyWithGainRampAVX512(float* output, const float* source, float startGain, float endGain, int numSamples)
+    {
+        const float step = (endGain - startGain) / static_cast<float>(numSamples);
+        const __m512 steps = _mm512_set1_ps(step);
+        __m512 positions = _mm512_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f,
+                                          8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f);
+        int i = 0;
+
+        for (; i + 16 <= numSamples; i += 16)
+        {
+            const __m512 gains = _mm512_add_ps(_mm512_set1_ps(startGain), _mm512_mul_ps(steps, positions));
+            _mm512_storeu_ps(output + i, _mm512_mul_ps(_mm512_loadu_ps(source + i), gains));
+            positions = _mm512_add_ps(positions, _mm512_set1_ps(16.0f));
+        }
+
+        copyWithGainRampTail(output, source, startGain, endGain, i, numSamples);
+    }
+
+    // Compress-store writes the hit indices straight out, with no bit loop
+    TEKHNE_TARGET("avx512f") int findIntersectingPairsAVX512(const CirclePairs& pairs, int numPairs, int* hits)
+    {
+        const __m512 zero = _mm512_setzero_ps();
+        const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+        int numHits = 0;
+        int i = 0;
+
+        for (; i + 16 <= numPairs; i += 16)
+        {
+            const __m512 dx = _mm512_sub_ps(_mm512_loadu_ps(pairs.x2 + i), _mm512_loadu_ps(pairs.x1 + i));
+            const __m512 dy = _mm512_sub_ps(_mm512_loadu_ps(pairs.y2 + i), _mm512_loadu_ps(pairs.y1 + i));
+            const __m512 r1 = _mm512_max_ps(_mm512_loadu_ps(pairs.r1 + i), zero);
+            const __m512 r2 = _mm512_max_ps(_mm512_loadu_ps(pairs.r2 + i), zero);
+            const __m512 distanceSquared = _mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy));
+            const __m512 sum = _mm512_add_ps(r1, r2);
+            const __m512 difference = _mm512_sub_ps(r1, r2);
+
+            const __mmask16 hit = _mm512_cmp_ps_mask(distanceSquared, _mm512_mul_ps(sum, sum), _CMP_LE_OQ)
+                                & _mm512_cmp_ps_mask(distanceSquared, _mm512_mul_ps(difference, difference), _CMP_GE_OQ);
+
+            _mm512_mask_compressstoreu_epi32(hits + numHits, hit, _mm512_add_epi32(lanes, _mm512_set1_epi32(i)));
+            numHits += juce::countNumberOfBits(static_cast<juce::uint32>(hit));
+        }
+
+        return findIntersectingPairsTail(pairs, i, numPairs, hits, numHits);
+    }
+
+    TEKHNE_TARGET("avx512f") void stepWaveRowAVX512(float* previous, const float* up, const float* centre, const float* down,
+                                                    float courant, float damping, int numCells)
+    {
+        const __m512 centreWeight = _mm512_set1_ps(2.0f - 4.0f * courant);
+        const __m512 courants = _mm512_set1_ps(courant);
+        const __m512 dampings = _mm512_set1_ps(damping);
+        int i = 0;
+
+        for (; i + 16 <= numCells; i += 16)
+        {
+            const __m512 neighbours = _mm512_add_ps(_mm512_add_ps(_mm512_loadu_ps(up + i), _mm512_loadu_ps(down + i)),
+                                                    _mm512_add_ps(_mm512_loadu_ps(centre + i - 1), _mm512_loadu_ps(centre + i + 1)));
+            const __m512 next = _mm512_sub_ps(_mm512_add_ps(_mm512_mul_ps(centreWeight, _mm512_loadu_ps(centre + i)), _mm512_mul_ps(courants, neighbours)),
+                                              _mm512_loadu_ps(previous + i));
+            _mm512_storeu_ps(previous + i, _mm512_mul_ps(dampings, next));
+        }
+
+        stepWaveRowTail(previous, up, centre, down, courant, damping, i, numCells);
+    }
+
+    TEKHNE_TARGET("avx512f") void addFMGrainAVX512(float* output, const FMGrain& grain, const float* table, int numSamples)
+    {
+        const __m512 envelopeStart = _mm512_set1_ps(grain.envelopePosition);
+        const __m512 envelopeStep = _mm512_set1_ps(grain.envelopeIncrement);
+        const __m512 carrierStart = _mm512_set1_ps(grain.carrierPhase);
+        const __m512 carrierStep = _mm512_set1_ps(grain.carrierIncrement);
+        const __m512 modulatorStart = _mm512_set1_ps(grain.modulatorPhase);
+        const __m512 modulatorStep = _mm512_set1_ps(grain.modulatorIncrement);
+        const __m512 index = _mm512_set1_ps(grain.modulationIndex);
+        const __m512 gain = _mm512_mul_ps(_mm512_set1_ps(grain.gain), _mm512_set1_ps(4.0f));
+        __m512 positions = _mm512_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f,
+                                            8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f);
+        int i = 0;
+
+        for (; i + 16 <= numSamples; i += 16)
+        {
+            const __m512 envelope = _mm512_add_ps(envelopeStart, _mm512_mul_ps(envelopeStep, positions));
+            const __m512 modulator = lookupSineAVX512(table, _mm512_add_ps(modulatorStart, _mm512_mul_ps(modulatorStep, positions)));
+            const __m512 phase = _mm512_add_ps(_mm512_add_ps(carrierStart, _mm512_mul_ps(carrierStep, positions)),
+                                               _mm512_mul_ps(index, modulator));
+            const __m512 shape = _mm512_mul_ps(envelope, _mm512_sub_ps(_mm512_set1_ps(1.0f), envelope));
+
+            _mm512_storeu_ps(output + i, _mm512_add_ps(_mm512_loadu_ps(output + i), _mm512_mul_ps(_mm512_mul_ps(gain, shape), lookupSineAVX512(table, phase))));
+            positions = _mm512_add_ps(positions, _mm512_set1_ps(16.0f));
+        }
+
+        addFMGrainTail(output, grain, table, i, numSamples);
+    }
+   #endif
+
+    //==============================================================================
+    const DSPKernels scalarKernels { KernelLevel::scalar, addModulatorScalar, renderSineScalar, copyWithGainRampScalar, findIntersectingPairsScalar, stepWaveRowScalar, addFMGrainScalar };
+
+   #if JUCE_INTEL
+    const DSPKernels sse2Kernels   { KernelLevel::sse2,   addModulatorSSE2,   renderSineSSE2,   copyWithGainRampSSE2,   findIntersectingPairsSSE2,   stepWaveRowSSE2,   addFMGrainSSE2 };
+    const DSPKernels avx2Kernels   { KernelLevel::avx2,   addModulatorAVX2,   renderSineAVX2,   copyWithGainRampAVX2,   findIntersectingPairsAVX2,   stepWaveRowAVX2,   addFMGrainAVX2 };
+    const DSPKernels avx512Kernels { KernelLevel::avx512, addModulatorAVX512, renderSineAVX512, copyWithGainRampAVX512, findIntersectingPairsAVX512, stepWaveRowAVX512, addFMGrainAVX512 };
+   #endif
+
+    KernelLevel getNarrowerLevel(KernelLevel level) noexcept
+    {
+        return level == KernelLevel::scalar ? KernelLevel::scalar
+                                            : static_cast<KernelLevel>(static_cast<int>(level) - 1);
+    }
+
+    struct EnvironmentDefaults
+    {
+        EnvironmentDefaults()
+        {
+            if (const auto* value = std::getenv("TEKHNE_DSP_KERNELS"))
+            {
+                for (auto level : { KernelLevel::scalar, KernelLevel::sse2, KernelLevel::avx2, KernelLevel::avx512 })
+                    if (std::strcmp(value, DSPKernels::getLevelName(level)) == 0)
+                        maximumLevel = level;
+            }
+        }
+    };
+
+    const EnvironmentDefaults environmentDefaults;
+}
+
+//==============================================================================
+const DSPKernels& DSPKernels::select() noexcept
+{
+    return get(maximumLevel.load());
+}
+
+const DSPKernels& DSPKernels::get(KernelLevel level) noexcept
+{
+    while (! isSupported(level))
+        level = getNarrowerLevel(level);
+
+    switch (level)
+    {
+       #if JUCE_INTEL
+        case KernelLevel::avx512:   return avx512Kernels;
+        case KernelLevel::avx2:     return avx2Kernels;
+        case KernelLevel::sse2:     return sse2Kernels;
+       #endif
+        default:                    return scalarKernels;
+    }
+}
+
+bool DSPKernels::isSupported(KernelLevel level) noexcept
+{
+   #if JUCE_INTEL
+    switch (level)
+    {
+        case KernelLevel::scalar:   return true;
+        case KernelLevel::sse2:     return juce::SystemStats::hasSSE2();
+        case KernelLevel::avx2:     return juce::SystemStats::hasAVX2();
+        case KernelLevel::avx512:   return juce::SystemStats::hasAVX512F();
+    }
+
+    return false;
+   #else
+    return level == KernelLevel::scalar;
+   #endif
+}
+
+void DSPKernels::setMaximumLevel(KernelLevel level) noexcept
+{
+    maximumLevel = level;
+}
+
+const char* DSPKernels::getLevelName(KernelLevel level) noexcept
+{
+    switch (level)
+    {
+        case KernelLevel::scalar:   return "scalar";
+        case KernelLevel::sse2:     return "sse2";
+        case KernelLevel::avx2:     return "avx2";
+        case KernelLevel::avx512:   return "avx512";
+    }
+
+    return "unknown";
+}
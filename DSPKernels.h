@@ -0,0 +1,109 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/*
+    The float inner loops of FMEngine, GrainEngine, SpatialPanner, the water
+    simulation and the editor's circle tests, built for several x86
+    instruction sets in the same binary. select() picks the widest one the
+    CPU supports. Call it off the audio thread (FMEngine does it in
+    prepare()) and keep the reference.
+
+    To test the narrower versions on a new machine, cap the level with
+    setMaximumLevel(), or set TEKHNE_DSP_KERNELS=scalar|sse2|avx2|avx512 in the
+    environment. Outside x86 only the scalar versions exist.
+
+    Every version computes the same linear-interpolated table sine as
+    SharedDSPTables::sine(). Results can differ in the last bit where the
+    compiler contracts a multiply-add.
+*/
+enum class KernelLevel
+{
+    scalar,
+    sse2,
+    avx2,
+    avx512
+};
+
+/** Candidate pairs of circles as separate arrays, (x1, y1, r1) against (x2, y2, r2). */
+struct CirclePairs
+{
+    const float* x1;
+    const float* y1;
+    const float* r1;
+    const float* x2;
+    const float* y2;
+    const float* r2;
+};
+
+/** A two-operator FM grain as it stands at the first sample of a run. Phases
+    are in radians and must stay non-negative once modulated, so keep the
+    carrier phase at least modulationIndex above 0.
+*/
+struct FMGrain
+{
+    float carrierPhase;
+    float carrierIncrement;
+    float modulatorPhase;
+    float modulatorIncrement;
+    float modulationIndex;
+    float envelopePosition;         // 0 to 1 over the grain
+    float envelopeIncrement;
+    float gain;
+};
+
+struct DSPKernels
+{
+    /** modulatedFreq[i] += ramp[i] * sin(phases[i]) */
+    using AddModulatorFunction = void (*)(float* modulatedFreq, const float* ramp, const float* phases,
+                                          const float* sineTable, int numSamples);
+
+    /** output[i] = gain * sin(phases[i]) */
+    using RenderSineFunction = void (*)(float* output, const float* phases, float gain,
+                                        const float* sineTable, int numSamples);
+
+    /** output[i] = source[i] * gain, with the gain moving linearly from startGain towards endGain */
+    using CopyWithGainRampFunction = void (*)(float* output, const float* source, float startGain, float endGain,
+                                              int numSamples);
+
+    /** Writes the index of every pair whose circles cross or touch to hits, in
+        order, and returns how many there were. Negative radii count as 0.
+    */
+    using FindIntersectingPairsFunction = int (*)(const CirclePairs& pairs, int numPairs, int* hits);
+
+    /** One row of the damped wave equation, written over the step before:
+        previous[i] = damping * (2 centre[i] - previous[i] + courant * laplacian[i]),
+        with the laplacian taken from up, down, centre[i - 1] and centre[i + 1].
+        centre[-1] and centre[numCells] must be readable.
+    */
+    using StepWaveRowFunction = void (*)(float* previous, const float* up, const float* centre, const float* down,
+                                         float courant, float damping, int numCells);
+
+    /** output[i] += gain * e (1 - e) * 4 * sin(carrier + index * sin(modulator)),
+        with e, carrier and modulator each moving on by their increment per sample.
+    */
+    using AddFMGrainFunction = void (*)(float* output, const FMGrain& grain, const float* sineTable, int numSamples);
+
+    KernelLevel level;
+    AddModulatorFunction addModulator;
+    RenderSineFunction renderSine;
+    CopyWithGainRampFunction copyWithGainRamp;
+    FindIntersectingPairsFunction findIntersectingPairs;
+    StepWaveRowFunction stepWaveRow;
+    AddFMGrainFunction addFMGrain;
+
+    //==============================================================================
+    /** The widest supported kernels, capped at the maximum level. */
+    static const DSPKernels& select() noexcept;
+
+    /** The kernels for one level, falling back to narrower ones if the CPU lacks it. */
+    static const DSPKernels& get(KernelLevel) noexcept;
+
+    static bool isSupported(KernelLevel) noexcept;
+
+    /** Forces select() down to at most this level; KernelLevel::avx512 lifts the cap. */
+    static void setMaximumLevel(KernelLevel) noexcept;
+
+    static const char* getLevelName(KernelLevel) noexcept;
+};
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/*
+    Block and per-stage timing for processBlock.
+
+    The audio thread wraps each callback in TEKHNE_PROFILE_BLOCK and each stage
+    in TEKHNE_PROFILE_STAGE. Every ~100 ms a snapshot is published through a
+    wait-free triple buffer; the editor reads the newest on its timer, however
+    long it was away. Build with TEKHNE_PROFILING=0 and
+    the macros expand to nothing and DSPProfiler is not compiled in.
+*/
+
+#ifndef TEKHNE_PROFILING
+ #define TEKHNE_PROFILING 1
+#endif
+
+#if TEKHNE_PROFILING && JUCE_INTEL
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+#endif
+
+enum class DSPStage
+{
+    ramps = 0,
+    modulators,
+    carrier,
+    reverb,
+    grains,
+    output,
+    numStages
+};
+
+inline const char* getDSPStageName(DSPStage stage)
+{
+    switch (stage)
+    {
+        case DSPStage::ramps:       return "ramps";
+        case DSPStage::modulators:  return "modulators";
+        case DSPStage::carrier:     return "carrier";
+        case DSPStage::reverb:      return "reverb";
+        case DSPStage::grains:      return "grains";
+        case DSPStage::output:      return "output";
+        case DSPStage::numStages:   break;
+    }
+
+    return "";
+}
+
+struct DSPProfileSnapshot
+{
+    static constexpr int numStages = static_cast<int>(DSPStage::numStages);
+
+    double loadProportion = 0.0;  // smoothed block time over block duration
+    double peakBlockMs = 0.0;     // worst single callback since the previous snapshot
+    std::array<uint64_t, numStages> stageCycles {};
+
+    double getStageProportion(DSPStage stage) const noexcept
+    {
+        const auto total = std::accumulate(stageCycles.begin(), stageCycles.end(), uint64_t { 0 });
+        return total > 0 ? static_cast<double>(stageCycles[static_cast<size_t>(stage)]) / static_cast<double>(total) : 0.0;
+    }
+};
+
+#if TEKHNE_PROFILING
+
+class DSPProfiler
+{
+public:
+    /** Cheapest monotonic counter available; only ever compared against itself. */
+    static uint64_t readCycleCounter() noexcept
+    {
+       #if JUCE_INTEL
+        return __rdtsc();
+       #elif JUCE_ARM && defined (__aarch64__)
+        uint64_t ticks;
+        asm volatile ("mrs %0, cntvct_el0" : "=r" (ticks));
+        return ticks;
+       #else
+        return static_cast<uint64_t>(juce::Time::getHighResolutionTicks());
+       #endif
+    }
+
+    void prepare(double sampleRate, int maximumBlockSize)
+    {
+        loadMeasurer.reset(sampleRate, maximumBlockSize);
+        samplesPerSnapshot = juce::jmax(1, static_cast<int>(sampleRate * 0.1));
+        samplesSinceSnapshot = 0;
+        pending = {};
+    }
+
+    //==============================================================================
+    class ScopedBlock
+    {
+    public:
+        ScopedBlock(DSPProfiler& p, int numSamplesToProcess) noexcept
+            : profiler(p),
+              timer(p.loadMeasurer, numSamplesToProcess),
+              numSamples(numSamplesToProcess),
+              startTicks(juce::Time::getHighResolutionTicks())
+        {}
+
+        ~ScopedBlock()
+        {
+            profiler.finishBlock(juce::Time::getHighResolutionTicks() - startTicks, numSamples);
+        }
+
+    private:
+        DSPProfiler& profiler;
+        juce::AudioProcessLoadMeasurer::ScopedTimer timer;
+        const int numSamples;
+        const juce::int64 startTicks;
+    };
+
+    class ScopedStage
+    {
+    public:
+        ScopedStage(DSPProfiler& p, DSPStage s) noexcept
+            : profiler(p), stage(static_cast<size_t>(s)), startCycles(readCycleCounter())
+        {}
+
+        ~ScopedStage()
+        {
+            profiler.pending.stageCycles[stage] += readCycleCounter() - startCycles;
+        }
+
+    private:
+        DSPProfiler& profiler;
+        const size_t stage;
+        const uint64_t startCycles;
+    };
+
+    //==============================================================================
+    /** Message thread: the newest snapshot, if one was published since the last call. */
+    bool getLatestSnapshot(DSPProfileSnapshot& result)
+    {
+        if ((shared.load(std::memory_order_relaxed) & freshBit) == 0)
+            return false;
+
+        readIndex = shared.exchange(readIndex, std::memory_order_acq_rel) & indexMask;
+        result = snapshots[static_cast<size_t>(readIndex)];
+        return true;
+    }
+
+private:
+    void finishBlock(juce::int64 elapsedTicks, int numSamples) noexcept
+    {
+        pending.peakBlockMs = juce::jmax(pending.peakBlockMs, juce::Time::highResolutionTicksToSeconds(elapsedTicks) * 1000.0);
+        samplesSinceSnapshot += numSamples;
+
+        if (samplesSinceSnapshot < samplesPerSnapshot)
+            return;
+
+        pending.loadProportion = loadMeasurer.getLoadAsProportion();
+
+        // Swaps the written buffer for the shared one, so an unread snapshot
+        // is replaced by this one rather than this one being dropped
+        snapshots[static_cast<size_t>(writeIndex)] = pending;
+        writeIndex = shared.exchange(writeIndex | freshBit, std::memory_order_acq_rel) & indexMask;
+
+        pending = {};
+        samplesSinceSnapshot = 0;
+    }
+
+    static constexpr int indexMask = 3, freshBit = 4;
+
+    juce::AudioProcessLoadMeasurer loadMeasurer;
+    DSPProfileSnapshot pending;
+    int samplesPerSnapshot = 4410;
+    int samplesSinceSnapshot = 0;
+
+    // Each of the three buffers belongs to the audio thread, the editor, or
+    // neither; shared holds the last's index, and freshBit while it is unread
+    std::array<DSPProfileSnapshot, 3> snapshots;
+    int writeIndex = 0;                 // audio thread
+    int readIndex = 1;                  // message thread
+    std::atomic<int> shared { 2 };
+
+    JUCE_DECLARE_NON_COPYABLE(DSPProfiler)
+};
+
+ #define TEKHNE_PROFILE_BLOCK(profiler, numSamples)  DSPProfiler::ScopedBlock JUCE_JOIN_MACRO(profiledBlock_, __LINE__) (profiler, numSamples)
+ #define TEKHNE_PROFILE_STAGE(profiler, stage)       DSPProfiler::ScopedStage JUCE_JOIN_MACRO(profiledStage_, __LINE__) (profiler, stage)
+
+#else
+
+ #define TEKHNE_PROFILE_BLOCK(profiler, numSamples)
+ #define TEKHNE_PROFILE_STAGE(profiler, stage)
+
+#endif
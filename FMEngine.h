@@ -0,0 +1,472 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "SharedDSPTables.h"
+#include "DSPKernels.h"
+
+//==============================================================================
+/*
+    The block-staged FM voice: a bank of ramped modulators summed into the
+    carrier frequency, then one table-sine carrier.
+
+    SampleType is float or double. Every constant is converted once in
+    prepare(), so the float build has no conversions inside its loops and the
+    double build keeps double precision in the phases and frequency sum.
+    NumModulators is fixed at compile time, so each loop has a known trip count.
+
+    Phases are accumulated one sample at a time into scratch, then the sine
+    lookups run as a separate pass over the block. For float that pass uses
+    the DSPKernels picked in prepare() for the CPU; double stays scalar.
+    Other shapes come from MipmappedWavetables, picking the octave from the
+    phase increment.
+
+    Everything here belongs to the audio thread. Call the stages in order,
+    renderRamps, renderModulators, then renderCarrier, once per chunk of up to
+    getMaximumBlockSize() samples. While isIdle(), renderIdle() does the same
+    job for a fraction of the cost. A voice that renders the modulators
+    itself calls renderRamps, then renderScaledRamps, and reads
+    getScaledRamp().
+*/
+template <typename SampleType, int NumModulators>
+class FMEngine
+{
+public:
+    static_assert(std::is_floating_point_v<SampleType>, "FMEngine needs a floating point sample type");
+
+    static constexpr int numModulators = NumModulators;
+
+    void prepare(double sampleRate, int maximumBlockSize)
+    {
+        radiansPerHz = static_cast<SampleType>(juce::MathConstants<double>::twoPi / sampleRate);
+
+        // The modulators advance by pi, not 2 pi, per cycle, as they always have
+        modulatorRadiansPerHz = juce::MathConstants<double>::pi / sampleRate;
+
+        for (auto& modulator : modulators)
+            modulator.increment = getModulatorIncrement(modulator.frequency);
+
+        scratch.setSize(numScratchChannels, maximumBlockSize);
+
+        if constexpr (std::is_same_v<SampleType, float>)
+            kernels = &DSPKernels::select();
+    }
+
+    /** The float kernels chosen at the last prepare(). */
+    KernelLevel getKernelLevel() const noexcept { return kernels->level; }
+
+    int getMaximumBlockSize() const noexcept { return scratch.getNumSamples(); }
+
+    //==============================================================================
+    /** Sets a modulator's frequency and restarts its ramp from wherever it is. */
+    void startModulator(int index, SampleType frequency) noexcept
+    {
+        auto& modulator = modulators[static_cast<size_t>(index)];
+        modulator.frequency = frequency;
+        modulator.increment = getModulatorIncrement(frequency);
+        modulator.completed = false;
+    }
+
+    /** Per-sample step of a modulator's ramp on the way up to the target and back down. */
+    void setRampIncrements(int index, SampleType up, SampleType down) noexcept
+    {
+        auto& modulator = modulators[static_cast<size_t>(index)];
+        modulator.rampUp = up;
+        modulator.rampDown = down;
+    }
+
+    /** Shapes for the carrier and the modulators, nullptr for the plain sine.
+        The tables must outlive their use; set them at the start of each block.
+    */
+    void setWavetables(const MipmappedWavetable* carrier, const MipmappedWavetable* modulator) noexcept
+    {
+        carrierWavetable = carrier;
+        modulatorWavetable = modulator;
+    }
+
+    const MipmappedWavetable* getCarrierWavetable() const noexcept      { return carrierWavetable; }
+    const MipmappedWavetable* getModulatorWavetable() const noexcept    { return modulatorWavetable; }
+
+    /** Keeps only the count modulators with the deepest ramps, fading the rest
+        out, and any that come back in, over fadeSamples. Call every block while
+        count is below NumModulators so the choice follows the ramps.
+    */
+    void setMaxActiveModulators(int count, int fadeSamples) noexcept
+    {
+        std::array<int, NumModulators> byDepth;
+        std::iota(byDepth.begin(), byDepth.end(), 0);
+        std::sort(byDepth.begin(), byDepth.end(), [this](int a, int b)
+        {
+            return modulators[static_cast<size_t>(a)].index > modulators[static_cast<size_t>(b)].index;
+        });
+
+        for (int rank = 0; rank < NumModulators; ++rank)
+            modulators[static_cast<size_t>(byDepth[static_cast<size_t>(rank)])].targetGain = rank < count ? 1 : 0;
+
+        gainStep = static_cast<SampleType>(1) / static_cast<SampleType>(juce::jmax(1, fadeSamples));
+    }
+
+    /** Scales a modulator's ramp on top of any fade, gliding there over the
+        next block. 1 leaves the ramp as it is.
+    */
+    void setModulatorDepth(int index, SampleType depth) noexcept
+    {
+        modulators[static_cast<size_t>(index)].targetDepth = depth;
+    }
+
+    SampleType getModulatorFrequency(int index) const noexcept { return modulators[static_cast<size_t>(index)].frequency; }
+
+    /** Where a modulator's ramp is now, from 0 up to the 1000 target. */
+    SampleType getModulationIndex(int index) const noexcept { return modulators[static_cast<size_t>(index)].index; }
+
+    SampleType getCarrierPhase() const noexcept { return carrierPhase; }
+
+    std::array<SampleType, NumModulators> getModulatorPhases() const noexcept
+    {
+        std::array<SampleType, NumModulators> phases;
+
+        for (size_t m = 0; m < phases.size(); ++m)
+            phases[m] = modulators[m].phase;
+
+        return phases;
+    }
+
+    /** True while no modulator is bending the carrier: every ramp is parked at
+        zero and won't move until the next startModulator().
+    */
+    bool isIdle() const noexcept
+    {
+        for (int m = 0; m < NumModulators; ++m)
+            if (! isModulatorAtRest(m))
+                return false;
+
+        return true;
+    }
+
+    /** True while one modulator's ramp is parked at zero until its next startModulator(). */
+    bool isModulatorAtRest(int index) const noexcept
+    {
+        const auto& modulator = modulators[static_cast<size_t>(index)];
+        return modulator.index == modulationStart && (modulator.completed || (modulator.increasing && modulator.rampUp == 0));
+    }
+
+    /** Stands in for all three stages while isIdle(). The carrier runs at a
+        steady frequency, so it is quantised once and no modulator sine is looked
+        up; the modulator phases just jump ahead so they line up when they restart.
+    */
+    void renderIdle(int numSamples, SampleType carrierFrequency, const SharedDSPTables& tables, const Tuning* quantiseTo) noexcept
+    {
+        for (int m = 0; m < NumModulators; ++m)
+        {
+            skipPhase(modulators[static_cast<size_t>(m)], numSamples);
+            juce::FloatVectorOperations::fill(scratch.getWritePointer(rampChannel + m), modulationStart, numSamples);
+        }
+
+        const SampleType frequency = quantiseTo != nullptr
+                                   ? static_cast<SampleType>(quantiseTo->quantise(static_cast<float>(carrierFrequency)))
+                                   : carrierFrequency;
+        const SampleType increment = frequency * radiansPerHz;
+        auto* phases = scratch.getWritePointer(phaseChannel);
+        auto* output = scratch.getWritePointer(carrierChannel);
+
+        for (int sample = 0; sample < numSamples; ++sample)
+        {
+            carrierPhase += increment;
+
+            if (carrierPhase >= twoPi)
+                carrierPhase -= twoPi;
+
+            phases[sample] = carrierPhase;
+        }
+
+        if (carrierWavetable != nullptr)
+        {
+            const int level = MipmappedWavetable::getLevel(static_cast<float>(increment));
+
+            for (int sample = 0; sample < numSamples; ++sample)
+                output[sample] = carrierWavetable->lookup(phases[sample], level) * outputLevel;
+        }
+        else
+        {
+            renderSines(output, phases, tables, numSamples);
+        }
+    }
+
+    //==============================================================================
+    /** Advances every modulator's index ramp, one scratch channel per modulator. */
+    void renderRamps(int numSamples) noexcept
+    {
+        for (int m = 0; m < NumModulators; ++m)
+        {
+            auto& modulator = modulators[static_cast<size_t>(m)];
+            auto* ramp = scratch.getWritePointer(rampChannel + m);
+
+            if (modulator.completed)
+            {
+                juce::FloatVectorOperations::fill(ramp, modulator.index, numSamples);
+                continue;
+            }
+
+            for (int sample = 0; sample < numSamples; ++sample)
+            {
+                if (! modulator.completed)
+                {
+                    if (modulator.increasing)
+                    {
+                        modulator.index += modulator.rampUp;
+
+                        if (modulator.index >= modulationTarget)
+                        {
+                            modulator.index = modulationTarget;
+                            modulator.increasing = false;
+                        }
+                    }
+                    else
+                    {
+                        modulator.index -= modulator.rampDown;
+
+                        if (modulator.index <= modulationStart)
+                        {
+                            modulator.index = modulationStart;
+                            modulator.increasing = true;
+                            modulator.completed = true;
+                        }
+                    }
+                }
+
+                ramp[sample] = modulator.index;
+            }
+        }
+    }
+
+    /** Sums the ramped modulators onto the carrier frequency. */
+    void renderModulators(int numSamples, SampleType carrierFrequency, const SharedDSPTables& tables) noexcept
+    {
+        auto* modulatedFreq = scratch.getWritePointer(frequencyChannel);
+        auto* phases = scratch.getWritePointer(phaseChannel);
+
+        juce::FloatVectorOperations::fill(modulatedFreq, carrierFrequency, numSamples);
+
+        for (int m = 0; m < NumModulators; ++m)
+        {
+            auto& modulator = modulators[static_cast<size_t>(m)];
+            const auto* ramp = scaleRamp(modulator, scratch.getReadPointer(rampChannel + m),
+                                         scratch.getWritePointer(fadedRampChannel), numSamples);
+
+            if (ramp == nullptr)
+            {
+                skipPhase(modulator, numSamples);
+                continue;
+            }
+
+            for (int sample = 0; sample < numSamples; ++sample)
+            {
+                phases[sample] = modulator.phase;
+                modulator.phase += modulator.increment;
+
+                if (modulator.phase >= twoPi)
+                    modulator.phase -= twoPi;
+            }
+
+            if (modulatorWavetable != nullptr)
+            {
+                // The increment is fixed for the block, so is the octave
+                const int level = MipmappedWavetable::getLevel(static_cast<float>(modulator.increment));
+
+                for (int sample = 0; sample < numSamples; ++sample)
+                    modulatedFreq[sample] += ramp[sample] * modulatorWavetable->lookup(phases[sample], level);
+            }
+            else if constexpr (std::is_same_v<SampleType, float>)
+            {
+                kernels->addModulator(modulatedFreq, ramp, phases, tables.getSineTable(), numSamples);
+            }
+            else
+            {
+                for (int sample = 0; sample < numSamples; ++sample)
+                    modulatedFreq[sample] += ramp[sample] * tables.sine(phases[sample]);
+            }
+        }
+    }
+
+    /** Runs the carrier over the modulated frequencies, optionally snapped to a tuning. */
+    void renderCarrier(int numSamples, const SharedDSPTables& tables, const Tuning* quantiseTo) noexcept
+    {
+        const auto* modulatedFreq = scratch.getReadPointer(frequencyChannel);
+        auto* phases = scratch.getWritePointer(phaseChannel);
+        auto* increments = scratch.getWritePointer(incrementChannel);
+        auto* output = scratch.getWritePointer(carrierChannel);
+
+        for (int sample = 0; sample < numSamples; ++sample)
+        {
+            const SampleType frequency = quantiseTo != nullptr
+                                       ? static_cast<SampleType>(quantiseTo->quantise(static_cast<float>(modulatedFreq[sample])))
+                                       : modulatedFreq[sample];
+
+            increments[sample] = frequency * radiansPerHz;
+            carrierPhase += increments[sample];
+
+            if (carrierPhase >= twoPi)
+                carrierPhase -= twoPi;
+            else if (carrierPhase < 0)
+                carrierPhase += twoPi; // deep modulation can push the carrier below 0 Hz
+
+            phases[sample] = carrierPhase;
+        }
+
+        if (carrierWavetable != nullptr)
+        {
+            // The modulated frequency moves every sample, and the octave with it
+            for (int sample = 0; sample < numSamples; ++sample)
+                output[sample] = carrierWavetable->lookup(phases[sample], MipmappedWavetable::getLevel(static_cast<float>(increments[sample])))
+                               * outputLevel;
+        }
+        else
+        {
+            renderSines(output, phases, tables, numSamples);
+        }
+    }
+
+    /** Stands in for renderModulators when something else plays the
+        modulators: each ramp with the modulator's fade and depth applied, as
+        renderModulators would have used it. The modulator phases just jump
+        ahead, as they do while idle.
+    */
+    void renderScaledRamps(int numSamples) noexcept
+    {
+        for (int m = 0; m < NumModulators; ++m)
+        {
+            auto& modulator = modulators[static_cast<size_t>(m)];
+            auto* scaled = scratch.getWritePointer(scaledRampChannel + m);
+            const auto* ramp = scaleRamp(modulator, scratch.getReadPointer(rampChannel + m), scaled, numSamples);
+
+            if (ramp == nullptr)
+                juce::FloatVectorOperations::clear(scaled, numSamples);
+            else if (ramp != scaled)
+                juce::FloatVectorOperations::copy(scaled, ramp, numSamples);
+
+            skipPhase(modulator, numSamples);
+        }
+    }
+
+    const SampleType* getOutput() const noexcept                { return scratch.getReadPointer(carrierChannel); }
+    const SampleType* getRamp(int index) const noexcept         { return scratch.getReadPointer(rampChannel + index); }
+
+    /** A ramp after renderScaledRamps(), from 0 up to the 1000 target times its depth. */
+    const SampleType* getScaledRamp(int index) const noexcept   { return scratch.getReadPointer(scaledRampChannel + index); }
+
+private:
+    // Not quite 2 pi; kept so the wrap points match the reference engine
+    static constexpr SampleType twoPi = static_cast<SampleType>(6.28318);
+    static constexpr SampleType modulationStart = 0;
+    static constexpr SampleType modulationTarget = 1000;
+    static constexpr SampleType outputLevel = static_cast<SampleType>(0.5);
+
+    enum ScratchChannels
+    {
+        rampChannel = 0,                    // one channel per modulator
+        frequencyChannel = NumModulators,
+        phaseChannel,
+        incrementChannel,
+        fadedRampChannel,
+        carrierChannel,
+        scaledRampChannel,                  // one channel per modulator
+        numScratchChannels = scaledRampChannel + NumModulators
+    };
+
+    struct Modulator
+    {
+        SampleType frequency = 0;
+        SampleType increment = 0;
+        SampleType phase = 0;
+
+        SampleType index = 0;
+        SampleType rampUp = 0;
+        SampleType rampDown = 0;
+        bool increasing = true;
+        bool completed = false;
+
+        SampleType gain = 1;            // faded in and out by setMaxActiveModulators()
+        SampleType targetGain = 1;
+        SampleType depth = 1;           // set by setModulatorDepth()
+        SampleType targetDepth = 1;
+    };
+
+    // Worked out in double even for float: the phase runs open-loop for the
+    // whole ramp, so a rounding error here turns into audible drift.
+    SampleType getModulatorIncrement(SampleType frequency) const noexcept
+    {
+        return static_cast<SampleType>(frequency * modulatorRadiansPerHz);
+    }
+
+    // Moves a modulator on without rendering it, so it is in phase when it's heard again
+    static void skipPhase(Modulator& modulator, int numSamples) noexcept
+    {
+        modulator.phase = std::fmod(modulator.phase + modulator.increment * static_cast<SampleType>(numSamples), twoPi);
+    }
+
+    // Glides a modulator's fade and depth over the block and applies them to
+    // its ramp. Returns the ramp itself if both stay at 1, destination if it
+    // had to be scaled, and nullptr if both stay at 0.
+    const SampleType* scaleRamp(Modulator& modulator, const SampleType* ramp, SampleType* destination, int numSamples) const noexcept
+    {
+        const SampleType startGain = modulator.gain;
+        const SampleType fade = gainStep * static_cast<SampleType>(numSamples);
+        modulator.gain = modulator.targetGain > startGain ? juce::jmin(modulator.targetGain, startGain + fade)
+                                                          : juce::jmax(modulator.targetGain, startGain - fade);
+
+        const SampleType startDepth = modulator.depth;
+        modulator.depth = modulator.targetDepth;
+
+        const SampleType startScale = startGain * startDepth;
+        const SampleType endScale = modulator.gain * modulator.depth;
+
+        if (startScale == 0 && endScale == 0)
+            return nullptr;
+
+        if (startScale == 1 && endScale == 1)
+            return ramp;
+
+        copyWithGainRamp(destination, ramp, startScale, endScale, numSamples);
+        return destination;
+    }
+
+    void copyWithGainRamp(SampleType* output, const SampleType* source, SampleType startGain, SampleType endGain, int numSamples) const noexcept
+    {
+        if constexpr (std::is_same_v<SampleType, float>)
+        {
+            kernels->copyWithGainRamp(output, source, startGain, endGain, numSamples);
+        }
+        else
+        {
+            const SampleType step = (endGain - startGain) / static_cast<SampleType>(numSamples);
+
+            for (int sample = 0; sample < numSamples; ++sample)
+                output[sample] = source[sample] * (startGain + step * static_cast<SampleType>(sample));
+        }
+    }
+
+    void renderSines(SampleType* output, const SampleType* phases, const SharedDSPTables& tables, int numSamples) const noexcept
+    {
+        if constexpr (std::is_same_v<SampleType, float>)
+        {
+            kernels->renderSine(output, phases, outputLevel, tables.getSineTable(), numSamples);
+        }
+        else
+        {
+            for (int sample = 0; sample < numSamples; ++sample)
+                output[sample] = tables.sine(phases[sample]) * outputLevel;
+        }
+    }
+
+    std::array<Modulator, NumModulators> modulators;
+    SampleType carrierPhase = 0;
+    SampleType gainStep = 1;
+
+    SampleType radiansPerHz = 0;
+    double modulatorRadiansPerHz = 0;
+
+    juce::AudioBuffer<SampleType> scratch;
+    const DSPKernels* kernels = &DSPKernels::get(KernelLevel::scalar);
+
+    const MipmappedWavetable* carrierWavetable = nullptr;
+    const MipmappedWavetable* modulatorWavetable = nullptr;
+};
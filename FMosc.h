@@ -1,63 +1,228 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "SharedDSPTables.h"
 
+//==============================================================================
+/*
+    One operator routing for FMOscillator, DX style.
+
+    Operator 0 runs at the carrier frequency; 1 to 4 follow the pond's
+    modulators. An operator can only be modulated by higher-numbered ones, so
+    rendering from the top down visits every source before its destination.
+*/
+struct FMAlgorithm
+{
+    static constexpr int numOperators = 5;
+
+    const char* name;
+    std::array<unsigned, numOperators> sources;     // bit s of sources[op] set: s modulates op
+    unsigned carriers;                              // bit op set: op is heard
+    int feedbackOperator;                           // the one the feedback parameter drives
+
+    constexpr bool modulates(int source, int op) const noexcept { return ((sources[static_cast<size_t>(op)] >> source) & 1u) != 0; }
+    constexpr bool isCarrier(int op) const noexcept             { return ((carriers >> op) & 1u) != 0; }
+
+    constexpr int getNumCarriers() const noexcept
+    {
+        int count = 0;
+
+        for (int op = 0; op < numOperators; ++op)
+            count += isCarrier(op) ? 1 : 0;
+
+        return count;
+    }
+};
+
+inline constexpr std::array<FMAlgorithm, 5> fmAlgorithms
+{{
+    // 4 -> 3 -> 2 -> 1 -> 0
+    { "Stack",      { 1u << 1, 1u << 2, 1u << 3, 1u << 4, 0 },                  1u << 0,                        4 },
+    // 1, 2, 3, 4 -> 0
+    { "Parallel",   { 0b11110u, 0, 0, 0, 0 },                                   1u << 0,                        4 },
+    // 2 -> 1 -> 0 and 4 -> 3 -> 0
+    { "Two stacks", { (1u << 1) | (1u << 3), 1u << 2, 0, 1u << 4, 0 },          1u << 0,                        4 },
+    // 4 -> 1, 2, 3 -> 0
+    { "Branch",     { (1u << 1) | (1u << 2) | (1u << 3), 1u << 4, 1u << 4, 1u << 4, 0 }, 1u << 0,              4 },
+    // 0 alone, 2 -> 1 and 4 -> 3, all three heard
+    { "Pairs",      { 0, 1u << 2, 0, 1u << 4, 0 },                              (1u << 0) | (1u << 1) | (1u << 3), 0 }
+}};
+
+static_assert([]
+{
+    for (const auto& algorithm : fmAlgorithms)
+        for (int op = 0; op < FMAlgorithm::numOperators; ++op)
+            if ((algorithm.sources[static_cast<size_t>(op)] & ((2u << op) - 1u)) != 0)
+                return false;
+
+    return true;
+}(), "an operator may only be modulated by higher-numbered operators");
+
+//==============================================================================
+/*
+    Phase-modulation voice of FMAlgorithm::numOperators table-sine operators,
+    routed by one of fmAlgorithms.
+
+    Every algorithm is compiled into its own render function, with the routing
+    folded in as constants and the operators unrolled, so the per-sample loop
+    has no graph to walk and no branches on the routing. setAlgorithm() just
+    picks one of those functions.
+
+    Each operator's output is levels[op][sample] * scale * shape(phase + input),
+    where input is the sum of its sources plus its own feedback: the average
+    of its last two shape values times the feedback amount in radians. The
+    shape is the operator's wavetable, or the table sine without one.
+
+    Everything apart from prepare() belongs to the audio thread.
+*/
+template <typename SampleType>
 class FMOscillator
 {
 public:
-    FMOscillator()
+    static_assert(std::is_floating_point_v<SampleType>, "FMOscillator needs a floating point sample type");
+
+    static constexpr int numOperators = FMAlgorithm::numOperators;
+    static constexpr int numAlgorithms = static_cast<int>(fmAlgorithms.size());
+
+    /** Per-sample level of each operator; nullptr holds it at 1. */
+    using Levels = std::array<const SampleType*, numOperators>;
+
+    void prepare(double sampleRate, int maximumBlockSize)
     {
-        // Initialize the oscillators with sine waves
-        carrier.initialise([](float x) { return std::sin(x); });
-        modulator.initialise([](float x) { return std::sin(x); });
+        radiansPerHz = static_cast<SampleType>(juce::MathConstants<double>::twoPi / sampleRate);
+
+        scratch.setSize(numScratchChannels, maximumBlockSize);
+        juce::FloatVectorOperations::fill(scratch.getWritePointer(unityChannel), static_cast<SampleType>(1), maximumBlockSize);
+
+        reset();
     }
 
-    void prepare(const juce::dsp::ProcessSpec& spec)
+    void reset() noexcept
     {
-        carrier.prepare(spec);
-        modulator.prepare(spec);
+        for (auto& op : operators)
+        {
+            op.phase = 0;
+            op.lastSine = 0;
+            op.previousSine = 0;
+        }
     }
 
-    void setCarrierFrequency(float frequency)
+    void setAlgorithm(int index) noexcept
     {
-        carrierFrequency = frequency;
-        carrier.setFrequency(carrierFrequency);
+        renderFunction = renderFunctions[static_cast<size_t>(juce::jlimit(0, numAlgorithms - 1, index))];
     }
 
-    void setModulatorFrequency(float frequency)
+    void setFrequency(int op, SampleType frequency) noexcept    { operators[static_cast<size_t>(op)].increment = frequency * radiansPerHz; }
+    void setScale(int op, SampleType scale) noexcept            { operators[static_cast<size_t>(op)].scale = scale; }
+    void setFeedback(int op, SampleType radians) noexcept       { operators[static_cast<size_t>(op)].feedback = radians * static_cast<SampleType>(0.5); }
+
+    /** nullptr for the table sine. The table must outlive its use; set it at the start of each block. */
+    void setWavetable(int op, const MipmappedWavetable* wavetable) noexcept { operators[static_cast<size_t>(op)].wavetable = wavetable; }
+
+    /** Renders up to the prepared block size into getOutput(). */
+    void render(Levels levels, int numSamples, const SharedDSPTables& tables) noexcept
     {
-        modulator.setFrequency(frequency);
+        jassert(numSamples <= scratch.getNumSamples());
+
+        for (auto& level : levels)
+            if (level == nullptr)
+                level = scratch.getReadPointer(unityChannel);
+
+        // The octave follows the operator's own frequency, not its modulation
+        for (auto& op : operators)
+            if (op.wavetable != nullptr)
+                op.wavetableLevel = MipmappedWavetable::getLevel(static_cast<float>(op.increment));
+
+        (this->*renderFunction)(levels, numSamples, tables);
     }
 
-    void setModulationIndex(float index)
+    const SampleType* getOutput() const noexcept { return scratch.getReadPointer(outputChannel); }
+
+private:
+    // Same wrap point as FMEngine, so the two voices share a phase convention
+    static constexpr SampleType twoPi = static_cast<SampleType>(6.28318);
+
+    enum ScratchChannels
     {
-        modulationIndex = index;
-    }
-    
-    void setModulationDepth(float depth)
+        outputChannel = 0,
+        unityChannel,
+        numScratchChannels
+    };
+
+    struct Operator
     {
-        modulationDepth = depth;
+        SampleType phase = 0;
+        SampleType increment = 0;
+        SampleType scale = 0;
+        SampleType feedback = 0;        // already halved to average the last two sines
+        SampleType lastSine = 0;
+        SampleType previousSine = 0;
+        const MipmappedWavetable* wavetable = nullptr;
+        int wavetableLevel = 0;
+    };
+
+    using Outputs = std::array<SampleType, numOperators>;
+    using RenderFunction = void (FMOscillator::*)(const Levels&, int, const SharedDSPTables&) noexcept;
+
+    template <int Algorithm>
+    void renderAlgorithm(const Levels& levels, int numSamples, const SharedDSPTables& tables) noexcept
+    {
+        renderOperators<Algorithm>(levels, numSamples, tables, std::make_index_sequence<numOperators>());
     }
 
-    void processBlock(juce::dsp::AudioBlock<float>& block)
+    template <int Algorithm, size_t... Ops>
+    void renderOperators(const Levels& levels, int numSamples, const SharedDSPTables& tables, std::index_sequence<Ops...>) noexcept
     {
-        for (size_t i = 0; i < block.getNumSamples(); ++i)
+        auto* output = scratch.getWritePointer(outputChannel);
+
+        for (int sample = 0; sample < numSamples; ++sample)
         {
-            float modulatedFreq = carrierFrequency + modulationDepth * modulationIndex * modulator.processSample(0.0f);
-            carrier.setFrequency(modulatedFreq);
+            Outputs outputs;
 
-            for (size_t channel = 0; channel < block.getNumChannels(); ++channel)
-            {
-                block.setSample(channel, i, carrier.processSample(0.0f));
-            }
+            // Top operator first, so each one's sources are ready when it runs
+            (renderOperator<Algorithm, numOperators - 1 - static_cast<int>(Ops)>(outputs, levels, sample, tables), ...);
+
+            output[sample] = (static_cast<SampleType>(0) + ... + (fmAlgorithms[Algorithm].isCarrier(static_cast<int>(Ops)) ? outputs[Ops] : 0));
         }
     }
 
-private:
-    juce::dsp::Oscillator<float> carrier { [](float x) { return std::sin(x); } };
-    juce::dsp::Oscillator<float> modulator { [](float x) { return std::sin(x); } };
+    template <int Algorithm, int Op>
+    void renderOperator(Outputs& outputs, const Levels& levels, int sample, const SharedDSPTables& tables) noexcept
+    {
+        auto& op = operators[static_cast<size_t>(Op)];
+
+        const SampleType input = sumSources<Algorithm, Op>(outputs, std::make_index_sequence<numOperators>())
+                               + op.feedback * (op.lastSine + op.previousSine);
+        const SampleType sine = op.wavetable != nullptr ? op.wavetable->lookup(op.phase + input, op.wavetableLevel)
+                                                        : tables.sine(op.phase + input);
+
+        op.previousSine = op.lastSine;
+        op.lastSine = sine;
+        outputs[static_cast<size_t>(Op)] = levels[static_cast<size_t>(Op)][sample] * op.scale * sine;
+
+        op.phase += op.increment;
+
+        if (op.phase >= twoPi)
+            op.phase -= twoPi;
+    }
+
+    template <int Algorithm, int Op, size_t... Sources>
+    static SampleType sumSources(const Outputs& outputs, std::index_sequence<Sources...>) noexcept
+    {
+        return (static_cast<SampleType>(0) + ... + (fmAlgorithms[Algorithm].modulates(static_cast<int>(Sources), Op) ? outputs[Sources] : 0));
+    }
+
+    template <size_t... Algorithms>
+    static constexpr std::array<RenderFunction, numAlgorithms> makeRenderFunctions(std::index_sequence<Algorithms...>) noexcept
+    {
+        return {{ &FMOscillator::renderAlgorithm<static_cast<int>(Algorithms)>... }};
+    }
+
+    static constexpr std::array<RenderFunction, numAlgorithms> renderFunctions = makeRenderFunctions(std::make_index_sequence<numAlgorithms>());
+
+    std::array<Operator, numOperators> operators;
+    RenderFunction renderFunction = renderFunctions[0];
 
-    float carrierFrequency = 440.0f;
-    float modulationIndex = 100.0f;
-    float modulationDepth = 1.0f;  // This represents the depth of the modulation
+    SampleType radiansPerHz = 0;
+    juce::AudioBuffer<SampleType> scratch;
 };
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <memory_resource>
+
+//==============================================================================
+/*
+    A bump allocator for data that only lives for one editor frame.
+
+    Allocations are carved off the front of one block; deallocation does
+    nothing, and reset() frees the whole block at once. It is a
+    std::pmr::memory_resource, so std::pmr containers can live in it.
+
+    A frame that outgrows the block borrows from the global heap, and the
+    next reset() replaces the block with one big enough for that frame. So
+    once the scene has grown as far as it will, frames stop calling the
+    global allocator at all.
+
+    Everything built on the arena must be gone before reset(). Message
+    thread only.
+*/
+class FrameArena : public std::pmr::memory_resource
+{
+public:
+    explicit FrameArena(size_t initialBytes = 64 * 1024)
+    {
+        allocateBlock(initialBytes);
+    }
+
+    ~FrameArena() override
+    {
+        releaseOverflow();
+        upstream->deallocate(block, capacity, blockAlignment);
+    }
+
+    /** Start of a frame: frees everything, and grows the block if the last frame didn't fit. */
+    void reset()
+    {
+        if (! overflow.empty())
+        {
+            const size_t needed = used + overflowBytes;
+
+            releaseOverflow();
+            upstream->deallocate(block, capacity, blockAlignment);
+            allocateBlock(juce::nextPowerOfTwo(static_cast<int>(needed)));
+        }
+
+        used = 0;
+    }
+
+    size_t getCapacity() const noexcept { return capacity; }
+
+    //==============================================================================
+    /** Hands back everything allocated during its lifetime when it goes out
+        of scope, so repeated paints between resets don't pile up. Whatever
+        used that memory must already be gone.
+    */
+    class ScopedRewind
+    {
+    public:
+        explicit ScopedRewind(FrameArena& a) noexcept : arena(a), mark(a.used) {}
+        ~ScopedRewind() noexcept { arena.used = juce::jmin(arena.used, mark); }
+
+    private:
+        FrameArena& arena;
+        const size_t mark;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedRewind)
+    };
+
+private:
+    static constexpr size_t blockAlignment = alignof(std::max_align_t);
+
+    struct Overflow
+    {
+        void* pointer;
+        size_t bytes, alignment;
+    };
+
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        const auto start = reinterpret_cast<std::uintptr_t>(block);
+        const auto aligned = (start + used + alignment - 1) & ~static_cast<std::uintptr_t>(alignment - 1);
+
+        if (aligned + bytes <= start + capacity)
+        {
+            used = aligned + bytes - start;
+            return reinterpret_cast<void*>(aligned);
+        }
+
+        auto* pointer = upstream->allocate(bytes, alignment);
+        overflow.push_back({ pointer, bytes, alignment });
+        overflowBytes += bytes + alignment;
+        return pointer;
+    }
+
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    void allocateBlock(size_t bytes)
+    {
+        capacity = bytes;
+        block = upstream->allocate(capacity, blockAlignment);
+    }
+
+    void releaseOverflow()
+    {
+        for (const auto& o : overflow)
+            upstream->deallocate(o.pointer, o.bytes, o.alignment);
+
+        overflow.clear();
+        overflowBytes = 0;
+    }
+
+    std::pmr::memory_resource* const upstream = std::pmr::new_delete_resource();
+    void* block = nullptr;
+    size_t capacity = 0;
+    size_t used = 0;
+
+    std::vector<Overflow> overflow;
+    size_t overflowBytes = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FrameArena)
+};
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "SharedDSPTables.h"
+#include "DSPKernels.h"
+#include "MultiProducerQueue.h"
+
+//==============================================================================
+/*
+    Short two-operator FM grains, requested from any thread and rendered on
+    the audio thread.
+
+    Requests wait in a bounded queue until the next beginBlock(). Live grains
+    sit in a fixed pool, packed at the front, so a block only visits the ones
+    that are sounding and a finished grain is swapped out in constant time.
+    Each grain's run in a block goes through DSPKernels::addFMGrain. Nothing
+    allocates after prepare(). A full queue or a full pool drops the request.
+
+    A request is stamped with the time it was made, on the
+    Time::getMillisecondCounterHiRes() clock. It starts latencyMs later, on
+    the sample that time falls on, so grains keep the spacing they were asked
+    for whenever the blocks happen to run.
+*/
+class GrainEngine
+{
+public:
+    static constexpr int maxGrains = 512;
+    static constexpr double latencyMs = 60.0;       // one editor frame
+
+    struct Request
+    {
+        double timeMs;
+        float frequency;
+        float modulatorRatio;       // modulator frequency over carrier frequency
+        float modulationIndex;      // peak phase deviation in radians
+        float durationMs;
+        float gain;
+    };
+
+    /** Call before playback starts. */
+    void prepare(double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        radiansPerHz = static_cast<float>(juce::MathConstants<double>::twoPi / sampleRate);
+        kernels = &DSPKernels::select();
+        numActive = 0;
+    }
+
+    /** Any thread: false if the request had to be dropped. */
+    bool trigger(const Request& request)
+    {
+        return requests.push(request);
+    }
+
+    /** Audio thread, once at the start of each block, with the time the block
+        started. Queued requests become grains, or are thrown away along with
+        every live grain if accept is false.
+    */
+    void beginBlock(double blockStartMs, bool accept) noexcept
+    {
+        requests.popAll([this, accept, blockStartMs](const Request& request)
+        {
+            if (accept)
+                start(request, blockStartMs);
+        });
+
+        if (! accept)
+            numActive = 0;
+    }
+
+    /** Audio thread: overwrites output with the next numSamples of every live grain. */
+    void render(float* output, int numSamples, const SharedDSPTables& tables) noexcept
+    {
+        juce::FloatVectorOperations::clear(output, numSamples);
+
+        for (int i = 0; i < numActive;)
+        {
+            auto& grain = grains[static_cast<size_t>(i)];
+
+            const int offset = juce::jmin(grain.delay, numSamples);
+            const int count = juce::jmin(numSamples - offset, grain.remaining);
+            grain.delay -= offset;
+
+            if (count > 0)
+            {
+                kernels->addFMGrain(output + offset, grain.state, tables.getSineTable(), count);
+                advance(grain, count);
+            }
+
+            if (grain.remaining == 0)
+                grain = grains[static_cast<size_t>(--numActive)];
+            else
+                ++i;
+        }
+    }
+
+    int getNumActiveGrains() const noexcept { return numActive; }
+
+private:
+    static constexpr int requestQueueSize = 1024;
+    static constexpr float twoPi = juce::MathConstants<float>::twoPi;
+
+    struct Grain
+    {
+        FMGrain state;
+        float phaseOffset;          // whole cycles added to the carrier so the modulated phase stays positive
+        int delay;                  // samples until it starts
+        int remaining;              // samples left to render
+    };
+
+    void start(const Request& request, double blockStartMs) noexcept
+    {
+        if (numActive == maxGrains)
+            return;
+
+        const int duration = juce::jmax(1, juce::roundToInt(request.durationMs * 0.001 * sampleRate));
+        const double delay = (request.timeMs + latencyMs - blockStartMs) * 0.001 * sampleRate;
+        const float index = juce::jmax(0.0f, request.modulationIndex);
+        const float phaseOffset = twoPi * std::ceil(index / twoPi);
+
+        auto& grain = grains[static_cast<size_t>(numActive++)];
+        grain.state = { phaseOffset,
+                        request.frequency * radiansPerHz,
+                        0.0f,
+                        request.frequency * request.modulatorRatio * radiansPerHz,
+                        index,
+                        0.0f,
+                        1.0f / static_cast<float>(duration),
+                        request.gain };
+        grain.phaseOffset = phaseOffset;
+        grain.delay = juce::jlimit(0, static_cast<int>(sampleRate), static_cast<int>(delay));
+        grain.remaining = duration;
+    }
+
+    static void advance(Grain& grain, int count) noexcept
+    {
+        const float samples = static_cast<float>(count);
+        auto& state = grain.state;
+
+        state.carrierPhase = grain.phaseOffset + std::fmod(state.carrierPhase - grain.phaseOffset + state.carrierIncrement * samples, twoPi);
+        state.modulatorPhase = std::fmod(state.modulatorPhase + state.modulatorIncrement * samples, twoPi);
+        state.envelopePosition += state.envelopeIncrement * samples;
+        grain.remaining -= count;
+    }
+
+    double sampleRate = 44100.0;
+    float radiansPerHz = 0.0f;
+    const DSPKernels* kernels = &DSPKernels::get(KernelLevel::scalar);
+
+    std::array<Grain, maxGrains> grains;    // audio thread; the first numActive are live
+    int numActive = 0;
+
+    MultiProducerQueue<Request, requestQueueSize> requests;
+};
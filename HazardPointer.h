@@ -0,0 +1,32 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/*
+    The reader's half of a hazard pointer, for objects published through an
+    atomic pointer and retired by a writer once they are replaced.
+
+    The reader marks what it is about to use in its own hazard slot, then
+    re-reads the published pointer in case it was replaced in between; once
+    the two agree, the writer is guaranteed to see the mark. The writer
+    publishes the replacement first, and may then delete any retired object
+    that no reader's hazard points at. The reader only goes round again
+    while the writer keeps replacing the object.
+*/
+template <typename Type>
+const Type* acquireHazardPointer(const std::atomic<const Type*>& published, std::atomic<const Type*>& hazard) noexcept
+{
+    auto* object = published.load();
+
+    for (;;)
+    {
+        hazard.store(object);
+        auto* latest = published.load();
+
+        if (latest == object)
+            return object;
+
+        object = latest;
+    }
+}
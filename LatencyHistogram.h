@@ -0,0 +1,384 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#if JUCE_MSVC
+ #include <intrin.h>
+#endif
+
+//==============================================================================
+/*
+    Tail-latency monitoring for processBlock.
+
+    LatencyHistogram is an HDR-style log-linear histogram: linear below 128 ns,
+    then 64 sub-buckets per power of two (<= 1.6 % relative error) up to ~34 s.
+    All memory is fixed, and recording is two shifts and one relaxed atomic
+    add, so the audio thread can record every callback.
+
+    Each processor owns a LatencyMonitor. A single LatencyReportWriter thread
+    for the whole process snapshots every registered monitor every few
+    seconds. It rewrites a JSON file with the full histograms and appends a
+    CSV row of percentiles up to p99.99, until the CSV reaches maxCsvBytes.
+    A processor is only registered once it has been prepared, and monitors
+    that haven't recorded anything yet are skipped.
+
+    Off by default: build with TEKHNE_LATENCY_HISTOGRAMS=1 to record and
+    write reports.
+*/
+
+#ifndef TEKHNE_LATENCY_HISTOGRAMS
+ #define TEKHNE_LATENCY_HISTOGRAMS 0
+#endif
+
+class LatencyHistogram
+{
+public:
+    static constexpr int linearBuckets = 128;
+    static constexpr int subBuckets = 64;
+    static constexpr int maxShift = 28;
+    static constexpr int numBuckets = linearBuckets + maxShift * subBuckets;
+
+    /** Audio thread: adds one sample. Only one thread may record. */
+    void record(uint64_t nanoseconds) noexcept
+    {
+        auto& bucket = counts[static_cast<size_t>(getBucketIndex(nanoseconds))];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        if (nanoseconds > maxValue.load(std::memory_order_relaxed))
+            maxValue.store(nanoseconds, std::memory_order_relaxed);
+    }
+
+    static int getBucketIndex(uint64_t value) noexcept
+    {
+        if (value < linearBuckets)
+            return static_cast<int>(value);
+
+        const int shift = juce::jmin(getHighestBit(value) - 6, maxShift);
+        const auto subBucket = juce::jmin(static_cast<int>(value >> shift), 2 * subBuckets - 1) - subBuckets;
+
+        return linearBuckets + (shift - 1) * subBuckets + subBucket;
+    }
+
+    /** The smallest value that lands in the given bucket. */
+    static uint64_t getBucketLowerBound(int index) noexcept
+    {
+        if (index < linearBuckets)
+            return static_cast<uint64_t>(index);
+
+        const int shift = (index - linearBuckets) / subBuckets + 1;
+        const auto subBucket = static_cast<uint64_t>((index - linearBuckets) % subBuckets + subBuckets);
+
+        return subBucket << shift;
+    }
+
+    //==============================================================================
+    /** A plain copy of the counters that can be analysed off the audio thread. */
+    struct Snapshot
+    {
+        std::array<uint64_t, numBuckets> counts {};
+        uint64_t total = 0;
+        uint64_t max = 0;
+
+        /** Value in nanoseconds below which the given fraction of samples fall. */
+        uint64_t getPercentile(double fraction) const noexcept
+        {
+            if (total == 0)
+                return 0;
+
+            const auto threshold = static_cast<uint64_t>(std::ceil(fraction * static_cast<double>(total)));
+            uint64_t seen = 0;
+
+            for (int i = 0; i < numBuckets; ++i)
+            {
+                seen += counts[static_cast<size_t>(i)];
+
+                if (seen >= threshold)
+                    return juce::jmin(max, i + 1 < numBuckets ? getBucketLowerBound(i + 1) - 1 : max);
+            }
+
+            return max;
+        }
+
+        uint64_t countAbove(uint64_t nanoseconds) const noexcept
+        {
+            uint64_t result = 0;
+
+            for (int i = getBucketIndex(nanoseconds) + 1; i < numBuckets; ++i)
+                result += counts[static_cast<size_t>(i)];
+
+            return result;
+        }
+    };
+
+    void takeSnapshot(Snapshot& snapshot) const noexcept
+    {
+        snapshot.total = 0;
+
+        for (size_t i = 0; i < counts.size(); ++i)
+        {
+            snapshot.counts[i] = counts[i].load(std::memory_order_relaxed);
+            snapshot.total += snapshot.counts[i];
+        }
+
+        snapshot.max = maxValue.load(std::memory_order_relaxed);
+    }
+
+private:
+    static int getHighestBit(uint64_t value) noexcept
+    {
+       #if JUCE_MSVC
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return static_cast<int>(index);
+       #else
+        return 63 - __builtin_clzll(value);
+       #endif
+    }
+
+    std::array<std::atomic<uint64_t>, numBuckets> counts {};
+    std::atomic<uint64_t> maxValue { 0 };
+};
+
+//==============================================================================
+/** processBlock duration and callback-to-callback jitter for one processor. */
+class LatencyMonitor
+{
+public:
+    void prepare(double newSampleRate, int newBlockSize) noexcept
+    {
+        sampleRate.store(newSampleRate);
+        blockSize.store(newBlockSize);
+        lastCallbackStart = 0;
+    }
+
+    /** Audio thread: call once per callback with the tick counts around it. */
+    void recordBlock(juce::int64 startTicks, juce::int64 endTicks) noexcept
+    {
+        blockDuration.record(ticksToNanoseconds(endTicks - startTicks));
+
+        if (lastCallbackStart != 0)
+            callbackInterval.record(ticksToNanoseconds(startTicks - lastCallbackStart));
+
+        lastCallbackStart = startTicks;
+    }
+
+    class ScopedBlock
+    {
+    public:
+        explicit ScopedBlock(LatencyMonitor& m) noexcept
+            : monitor(m), startTicks(juce::Time::getHighResolutionTicks())
+        {}
+
+        ~ScopedBlock()
+        {
+            monitor.recordBlock(startTicks, juce::Time::getHighResolutionTicks());
+        }
+
+    private:
+        LatencyMonitor& monitor;
+        const juce::int64 startTicks;
+    };
+
+    const LatencyHistogram& getBlockDurations() const noexcept      { return blockDuration; }
+    const LatencyHistogram& getCallbackIntervals() const noexcept   { return callbackInterval; }
+
+    /** The real-time budget of one nominal block, in nanoseconds. */
+    uint64_t getBlockDeadline() const noexcept
+    {
+        const auto rate = sampleRate.load();
+        return rate > 0.0 ? static_cast<uint64_t>(1.0e9 * blockSize.load() / rate) : 0;
+    }
+
+    double getSampleRate() const noexcept   { return sampleRate.load(); }
+    int getBlockSize() const noexcept       { return blockSize.load(); }
+
+private:
+    uint64_t ticksToNanoseconds(juce::int64 ticks) const noexcept
+    {
+        return ticks > 0 ? static_cast<uint64_t>(static_cast<double>(ticks) * nanosecondsPerTick) : 0;
+    }
+
+    LatencyHistogram blockDuration, callbackInterval;
+    juce::int64 lastCallbackStart = 0;
+    const double nanosecondsPerTick = 1.0e9 / static_cast<double>(juce::Time::getHighResolutionTicksPerSecond());
+
+    std::atomic<double> sampleRate { 0.0 };
+    std::atomic<int> blockSize { 0 };
+};
+
+//==============================================================================
+/** Process-wide background writer; hold it with juce::SharedResourcePointer. */
+class LatencyReportWriter : private juce::Thread
+{
+public:
+    LatencyReportWriter() : juce::Thread("Tekhne latency report")
+    {
+        outputDirectory = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                              .getChildFile("Tekhne").getChildFile("Latency");
+        sessionName = juce::Time::getCurrentTime().formatted("%Y%m%d-%H%M%S");
+    }
+
+    ~LatencyReportWriter() override
+    {
+        stopThread(2000);
+    }
+
+    /** Message thread. Adding a monitor again does nothing; it must be removed before it is destroyed. */
+    void addMonitor(const LatencyMonitor* monitor, const juce::String& instanceName)
+    {
+        {
+            const juce::ScopedLock sl(lock);
+
+            if (std::any_of(monitors.begin(), monitors.end(), [monitor](const Entry& e) { return e.monitor == monitor; }))
+                return;
+
+            monitors.push_back({ monitor, instanceName + "-" + juce::String(nextInstanceNumber++) });
+        }
+
+        if (! isThreadRunning())
+            startThread();
+    }
+
+    void removeMonitor(const LatencyMonitor* monitor)
+    {
+        {
+            const juce::ScopedLock sl(lock);
+            auto entry = std::find_if(monitors.begin(), monitors.end(), [monitor](const Entry& e) { return e.monitor == monitor; });
+
+            if (entry != monitors.end())
+            {
+                writeReport(*entry); // keep the final numbers of this instance
+                monitors.erase(entry);
+            }
+        }
+    }
+
+    static constexpr int reportIntervalMs = 10000;
+    static constexpr juce::int64 maxCsvBytes = 16 * 1024 * 1024;
+
+private:
+    struct Entry
+    {
+        const LatencyMonitor* monitor;
+        juce::String name;
+    };
+
+    void run() override
+    {
+        outputDirectory.createDirectory();
+
+        while (! threadShouldExit())
+        {
+            wait(reportIntervalMs);
+
+            const juce::ScopedLock sl(lock);
+
+            for (auto& entry : monitors)
+                writeReport(entry);
+        }
+    }
+
+    void writeReport(const Entry& entry)
+    {
+        static constexpr std::array<double, 5> percentiles { 0.5, 0.9, 0.99, 0.999, 0.9999 };
+
+        const auto& monitor = *entry.monitor;
+        const auto deadline = monitor.getBlockDeadline();
+
+        monitor.getBlockDurations().takeSnapshot(blockSnapshot);
+        monitor.getCallbackIntervals().takeSnapshot(intervalSnapshot);
+
+        // Prepared but never played: nothing worth a file
+        if (blockSnapshot.total == 0)
+            return;
+
+        auto toMicroseconds = [](uint64_t ns) { return juce::String(static_cast<double>(ns) * 1.0e-3, 2); };
+
+        auto describe = [&](const LatencyHistogram::Snapshot& snapshot)
+        {
+            juce::String json;
+            json << "{ \"count\": " << juce::String(snapshot.total);
+
+            for (auto p : percentiles)
+                json << ", \"p" << juce::String(p * 100.0, 3) << "_us\": " << toMicroseconds(snapshot.getPercentile(p));
+
+            json << ", \"max_us\": " << toMicroseconds(snapshot.max) << ", \"buckets\": [";
+
+            bool first = true;
+
+            for (int i = 0; i < LatencyHistogram::numBuckets; ++i)
+            {
+                if (snapshot.counts[static_cast<size_t>(i)] == 0)
+                    continue;
+
+                json << (first ? "" : ", ") << "[" << toMicroseconds(LatencyHistogram::getBucketLowerBound(i)) << ", " << juce::String(snapshot.counts[static_cast<size_t>(i)]) << "]";
+                first = false;
+            }
+
+            return json + "] }";
+        };
+
+        juce::String json;
+        json << "{\n  \"instance\": \"" << entry.name << "\",\n"
+             << "  \"sampleRate\": " << juce::String(monitor.getSampleRate()) << ",\n"
+             << "  \"blockSize\": " << juce::String(monitor.getBlockSize()) << ",\n"
+             << "  \"deadline_us\": " << toMicroseconds(deadline) << ",\n"
+             << "  \"overBudgetBlocks\": " << juce::String(deadline > 0 ? blockSnapshot.countAbove(deadline) : 0) << ",\n"
+             << "  \"processBlock\": " << describe(blockSnapshot) << ",\n"
+             << "  \"callbackInterval\": " << describe(intervalSnapshot) << "\n}\n";
+
+        const auto baseName = sessionName + "-" + entry.name;
+        outputDirectory.getChildFile(baseName + ".json").replaceWithText(json);
+
+        auto csv = outputDirectory.getChildFile(baseName + ".csv");
+
+        if (csv.getSize() >= maxCsvBytes)
+            return;
+
+        juce::String row;
+
+        if (! csv.existsAsFile())
+        {
+            row << "time,metric,count";
+
+            for (auto p : percentiles)
+                row << ",p" << juce::String(p * 100.0, 3) << "_us";
+
+            row << ",max_us,over_budget\n";
+        }
+
+        const auto now = juce::Time::getCurrentTime().toISO8601(true);
+
+        auto appendRow = [&](const char* metric, const LatencyHistogram::Snapshot& snapshot, uint64_t overBudget)
+        {
+            row << now << "," << metric << "," << juce::String(snapshot.total);
+
+            for (auto p : percentiles)
+                row << "," << toMicroseconds(snapshot.getPercentile(p));
+
+            row << "," << toMicroseconds(snapshot.max) << "," << juce::String(overBudget) << "\n";
+        };
+
+        appendRow("processBlock", blockSnapshot, deadline > 0 ? blockSnapshot.countAbove(deadline) : 0);
+        appendRow("callbackInterval", intervalSnapshot, 0);
+        csv.appendText(row);
+    }
+
+    juce::CriticalSection lock;
+    std::vector<Entry> monitors;
+    int nextInstanceNumber = 1;
+
+    juce::File outputDirectory;
+    juce::String sessionName;
+
+    // Large, so they live here rather than on the writer's stack
+    LatencyHistogram::Snapshot blockSnapshot, intervalSnapshot;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LatencyReportWriter)
+};
+
+#if TEKHNE_LATENCY_HISTOGRAMS
+ #define TEKHNE_RECORD_BLOCK_LATENCY(monitor)  LatencyMonitor::ScopedBlock JUCE_JOIN_MACRO(latencyScope_, __LINE__) (monitor)
+#else
+ #define TEKHNE_RECORD_BLOCK_LATENCY(monitor)
+#endif
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/*
+    A bounded queue that any thread can push to and a single thread drains.
+
+    Items sit in a juce::AbstractFifo. Consumers and producers never wait on
+    each other; the spin lock only serialises producers. Neither side
+    allocates, and a push to a full queue is dropped. As with AbstractFifo,
+    one of the Capacity places is always left empty.
+*/
+template <typename Item, int Capacity>
+class MultiProducerQueue
+{
+public:
+    /** Any thread: false if the queue was full and the item was dropped. */
+    bool push(const Item& item) noexcept
+    {
+        const juce::SpinLock::ScopedLockType sl(writeLock);
+
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+        if (size1 == 0)
+            return false;
+
+        items[static_cast<size_t>(start1)] = item;
+        fifo.finishedWrite(1);
+        return true;
+    }
+
+    /** Consumer thread only: calls use(item) on every waiting item, oldest
+        first, and returns how many there were.
+    */
+    template <typename Callback>
+    int popAll(Callback&& use)
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(fifo.getNumReady(), start1, size1, start2, size2);
+
+        for (int i = 0; i < size1; ++i)
+            use(items[static_cast<size_t>(start1 + i)]);
+
+        for (int i = 0; i < size2; ++i)
+            use(items[static_cast<size_t>(start2 + i)]);
+
+        fifo.finishedRead(size1 + size2);
+        return size1 + size2;
+    }
+
+private:
+    juce::AbstractFifo fifo { Capacity };
+    std::array<Item, Capacity> items;
+    juce::SpinLock writeLock;
+};
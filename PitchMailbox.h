@@ -0,0 +1,63 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/*
+    Hands generated pitches (from wave crossings) to the audio thread without
+    going through a parameter.
+
+    Only the newest pitch matters, so posting overwrites whatever is waiting
+    and never blocks. The audio thread picks it up with fetch() once per
+    block. Host notification is separate and coalesced: takeForHost() gives
+    the message thread at most one pitch per interval, however many were
+    posted in between.
+*/
+class PitchMailbox
+{
+public:
+    /** Any thread. */
+    void post(float frequency) noexcept
+    {
+        latest.store(frequency, std::memory_order_relaxed);
+        sequence.fetch_add(1, std::memory_order_release);
+    }
+
+    /** Audio thread: true, with the newest pitch, if one arrived since the last call. */
+    bool fetch(float& frequency) noexcept
+    {
+        const auto current = sequence.load(std::memory_order_acquire);
+
+        if (current == audioSequence)
+            return false;
+
+        audioSequence = current;
+        frequency = latest.load(std::memory_order_relaxed);
+        return true;
+    }
+
+    /** Message thread: true, with the newest pitch, if one arrived since the
+        last time the host was told and at least intervalMs have passed.
+    */
+    bool takeForHost(float& frequency, juce::uint32 intervalMs) noexcept
+    {
+        const auto current = sequence.load(std::memory_order_acquire);
+        const auto now = juce::Time::getMillisecondCounter();
+
+        if (current == hostSequence || now - lastHostUpdateMs < intervalMs)
+            return false;
+
+        hostSequence = current;
+        lastHostUpdateMs = now;
+        frequency = latest.load(std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    std::atomic<float> latest { 0.0f };
+    std::atomic<juce::uint32> sequence { 0 };
+
+    juce::uint32 audioSequence = 0;     // audio thread only
+    juce::uint32 hostSequence = 0;      // message thread only
+    juce::uint32 lastHostUpdateMs = 0;
+};
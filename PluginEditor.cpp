@@ -42,6 +42,7 @@ TekhneAudioProcessorEditor::TekhneAudioProcessorEditor (TekhneAudioProcessor& p)
     waveDistance.setColour(juce::Slider::thumbColourId, juce::Colours::white);
     waveDistance.setColour(juce::Slider::trackColourId, juce::Colours::white);
     waveDistance.setTextBoxStyle(juce::Slider::NoTextBox, false, 0, 0);  // Disable built-in text box
+    waveDistance.addListener(this);
 
     addAndMakeVisible(waveDistance);
 
@@ -67,32 +68,116 @@ TekhneAudioProcessorEditor::TekhneAudioProcessorEditor (TekhneAudioProcessor& p)
     carrierFreqLabel.setJustificationType(juce::Justification::centredRight);
     addAndMakeVisible(carrierFreqLabel);
     
+    setColour(juce::Slider::thumbColourId, juce::Colours::white);
+    setColour(juce::Slider::trackColourId, juce::Colours::white);
+    
+   #if TEKHNE_PROFILING
+    cpuLoadLabel.setJustificationType(juce::Justification::centredLeft);
+    cpuLoadLabel.setColour(juce::Label::textColourId, juce::Colours::white.withAlpha(0.7f));
+    addAndMakeVisible(cpuLoadLabel);
+   #endif
+    
+    addAndMakeVisible(scopeView);
+    addAndMakeVisible(spectrumView);
+    
+    waveformPad.onCycleDrawn = [this](const float* cycle, int numPoints) { audioProcessor.setDrawnWaveform(cycle, numPoints); };
+    addAndMakeVisible(waveformPad);
+    
+    scopePeaks.resize(512);
+    spectrumFrame.resize(AnalyserFeed::fftSize);
+    waves.reserve(initialWaveCapacity);
+    crossings.reserve(initialCrossingCapacity);
+    previousCrossings.reserve(initialCrossingCapacity);
+    audioProcessor.getAnalyserFeed().setActive(true);
+    
+    sliderValueChanged(&waveDistance);
+    
     setSize(700, 700);
+    waveEmissions.reset(juce::Time::getCurrentTime().toMilliseconds());
     startTimer(60);
 }
 
 TekhneAudioProcessorEditor::~TekhneAudioProcessorEditor()
 {
     stopTimer();
+    audioProcessor.getAnalyserFeed().setActive(false);
+    
+    for (const auto& circle : circles)
+        audioProcessor.releaseModulator(circle.modulator);
 }
 
-void TekhneAudioProcessorEditor::getIntersectionsX()
+void TekhneAudioProcessorEditor::postCrossingPitch(const CircleIntersectionBatch::Intersection& intersection)
 {
-    if (!intersectionPairs.empty())
-       {
-           auto latestIntersectionX = intersectionPairs.back().x1;
-           auto width = getWidth();
+    // Straight to the audio thread; the processor decides whether the host hears about it
+    audioProcessor.postGeneratedPitch(getPitchAt(intersection.x1));
+}
 
-           juce::NormalisableRange<float> frequencyRange(2000.0f, 5.0f);
-           float frequencyValue = frequencyRange.convertFrom0to1(latestIntersectionX / static_cast<float>(width));
-           
-           float quantizedFrequency = quantizeFrequency(frequencyValue);
+float TekhneAudioProcessorEditor::getPitchAt(float x) const
+{
+    const auto width = static_cast<float>(getWidth());
 
-           audioProcessor.treeState.getParameter("frequency")->setValueNotifyingHost(frequencyRange.convertTo0to1(static_cast<float>(quantizedFrequency)));
-       }
+    // High on the left, low on the right
+    const juce::NormalisableRange<float> frequencyRange(5.0f, 2000.0f);
+    float frequencyValue = frequencyRange.convertFrom0to1(1.0f - juce::jlimit(0.0f, width, x) / width);
+    
+    return audioProcessor.getTuning().quantise(frequencyValue);
+}
+
+void TekhneAudioProcessorEditor::triggerGrain(const CircleIntersectionBatch::Intersection& intersection, double timeMs)
+{
+    // Waves flatten as they spread, so two young waves crossing make the loudest grain
+    const float amplitude = juce::jmin(1.0f, grainReferenceRadius / std::sqrt(juce::jmax(1.0f, intersection.r1 * intersection.r2)));
+    
+    // and the higher up the pond they cross, the brighter it is
+    const float height = juce::jlimit(0.0f, 1.0f, intersection.y1 / static_cast<float>(getHeight()));
+    
+    audioProcessor.triggerGrain({ timeMs, getPitchAt(intersection.x1),
+                                  2.0f, juce::jmap(height, 4.0f, 0.5f), grainDurationMs, amplitude });
 }
 
 
+#if TEKHNE_PROFILING
+void TekhneAudioProcessorEditor::updateCpuLoadLabel()
+{
+    const auto nowMs = juce::Time::getMillisecondCounter();
+
+    if (nowMs - lastCpuLoadLabelMs < cpuLoadLabelIntervalMs)
+        return;
+
+    DSPProfileSnapshot snapshot;
+
+    if (! audioProcessor.getProfiler().getLatestSnapshot(snapshot))
+        return;
+
+    lastCpuLoadLabelMs = nowMs;
+
+    // Formatted on the stack; only a change of text reaches the label as a juce::String
+    std::array<char, 256> text;
+    int length = std::snprintf(text.data(), text.size(), "CPU %.1f%%  peak %.2f ms",
+                               snapshot.loadProportion * 100.0, snapshot.peakBlockMs);
+
+    auto append = [&text, &length](const char* format, auto... args)
+    {
+        if (length < static_cast<int>(text.size()))
+            length += std::snprintf(text.data() + length, text.size() - static_cast<size_t>(length), format, args...);
+    };
+
+    if (const int qualityLevel = audioProcessor.getQualityLevel())
+        append("  quality -%d", qualityLevel);
+
+    append("%s", "  |");
+
+    for (int i = 0; i < DSPProfileSnapshot::numStages; ++i)
+    {
+        const auto stage = static_cast<DSPStage>(i);
+        append("  %s %.0f%%", getDSPStageName(stage), snapshot.getStageProportion(stage) * 100.0);
+    }
+
+    if (cpuLoadLabel.getText() != text.data())
+        cpuLoadLabel.setText(text.data(), juce::dontSendNotification);
+}
+#endif
+
 void TekhneAudioProcessorEditor::sliderValueChanged(juce::Slider* slider)
 {
     if (slider == &radiusSlider)
@@ -102,13 +187,15 @@ void TekhneAudioProcessorEditor::sliderValueChanged(juce::Slider* slider)
     if (slider == &waveDistance)
     {
 //        audioProcessor.setModulatorParameters(distance_center, modulationIndexID, waveLife);
+        const auto range = waveDistance.getRange();
+        audioProcessor.getWater().setViscosity(static_cast<float>((waveDistance.getValue() - range.getStart()) / range.getLength()));
     }
     else if (slider == &carrierFreq)
        {
            carrierFreqValueLabel.setText(juce::String(carrierFreq.getValue()) + " Hz", juce::dontSendNotification);
            
            float freq = carrierFreq.getValue();
-           float value = quantizeFrequency(freq);
+           float value = audioProcessor.getTuning().quantise(freq);
            audioProcessor.treeState.getParameter("frequency")->setValueNotifyingHost(audioProcessor.treeState.getParameter("frequency")->getNormalisableRange().convertTo0to1(value));
        }
     else if (slider == &modFreq)
@@ -140,10 +227,11 @@ void TekhneAudioProcessorEditor::erasingCircles()
     int lifeSpan = static_cast<int>(fadeOutDuration);
 
     waves.erase(std::remove_if(waves.begin(), waves.end(),
-           [now, lifeSpan](const Wave& wave)
+           [this, now, lifeSpan](const Wave& wave)
            {
-               // Find if the corresponding circle is dead
-               return (now - wave.creationTime).inSeconds() >= lifeSpan ;
+               // Find if the corresponding circle is dead, or if the wave has
+               // grown past every corner of the view and can never be seen again
+               return (now - wave.creationTime).inSeconds() >= lifeSpan || enclosesView(wave, calculateRadius(wave, now));
            }),
            waves.end());
 
@@ -151,7 +239,7 @@ void TekhneAudioProcessorEditor::erasingCircles()
         {
             if ((now - it->creationTime).inSeconds() >= lifeSpan)
             {
-                availableIDs.insert(it->id);  // Recycle the ID
+                audioProcessor.releaseModulator(it->modulator);  // Handed out again once it has faded
                 it = circles.erase(it);       // Remove the circle and update the iterator
             }
             else
@@ -159,208 +247,336 @@ void TekhneAudioProcessorEditor::erasingCircles()
                 ++it;  // Increment the iterator only if no circle was erased
             }
         }
-
-    intersectionPairs.erase(
-            std::remove_if(intersectionPairs.begin(), intersectionPairs.end(),
-                [this](const IntersectionPair& intersection)
-                {
-                    // Get the circles from the stored coordinates
-                    auto circle1It = std::find_if(waves.begin(), waves.end(),
-                        [&intersection](const Wave& w) {
-                            return w.x == intersection.x1 && w.y == intersection.y1;
-                        });
-
-                    auto circle2It = std::find_if(waves.begin(), waves.end(),
-                        [&intersection](const Wave& w) {
-                            return w.x == intersection.x2 && w.y == intersection.y2;
-                        });
-
-                    // Check if circles are still present
-                    if (circle1It == waves.end() || circle2It == waves.end())
-                        return true; // Remove if either circle is missing
-
-                    const Wave& w1 = *circle1It;
-                    const Wave& w2 = *circle2It;
-                    float r1 = calculateRadius(w1);
-                    float r2 = calculateRadius(w2);
-
-                    // Check if the circles still intersect
-                    return !doCirclesIntersect(w1.x, w1.y, r1, w2.x, w2.y, r2);
-                }),
-            intersectionPairs.end());
 }
 
 void TekhneAudioProcessorEditor::update()
     {
+        // Last frame's crossings go before the arena is rewound for this one
+        intersectionPairs = std::pmr::vector<IntersectionPair>(&frameArena);
+        frameArena.reset();
+    
         erasingCircles();
+        updateCircles();
 
-        for (auto& circle : circles)
-            {
-                float elapsedTime = (juce::Time::getCurrentTime() - circle.creationTime).inSeconds();
+        waveEmissions.advance(juce::Time::getCurrentTime().toMilliseconds(),
+                              [this](juce::int64 dueMs, int serial) { emitWave(dueMs, serial); });
+    
+        updateWaterImage();
+    
+        findIntersections();
+    
+        repaint();
+    }
+
+void TekhneAudioProcessorEditor::updateCircles()
+{
+    for (auto& circle : circles)
+    {
+        calculateOpacity(circle, decrementRate);
         
-                    if (elapsedTime <= 0.2f || (elapsedTime >= 1.0f && std::fmod(elapsedTime, circle.waveDistance) < 0.1f))
-                    {
-                        waves.push_back(circle);
-                    }
+        // Circles don't move, so this only sends for new ones, or ones whose
+        // command didn't fit in the queue last time
+        if (! circle.modulatorSent)
+            sendModulatorParameters(circle);
+    }
+}
 
-            }
+void TekhneAudioProcessorEditor::sendModulatorParameters(Circle& circle)
+{
+    const juce::Point<float> offsetFromCentre { static_cast<float>(circle.x - getWidth() / 2), static_cast<float>(circle.y - getHeight() / 2) };
     
-        repaint();
+    circle.modulatorSent = audioProcessor.setModulatorParameters(offsetFromCentre, circle.modulator, circle.waveDistance);
+}
+
+void TekhneAudioProcessorEditor::emitWave(juce::int64 dueMs, int serial)
+{
+    const auto circle = std::find_if(circles.begin(), circles.end(),
+                                     [serial](const Circle& c) { return c.serial == serial; });
+    
+    // Circles that have been erased just stop; nothing else cancels them
+    if (circle == circles.end())
+        return;
+    
+    const auto endMs = circle->creationTime.toMilliseconds() + static_cast<juce::int64>(fadeOutDuration * 1000.0f);
+    
+    if (dueMs >= endMs)
+        return;
+    
+    waves.emplace_back(*circle);
+    waves.back().creationTime = juce::Time(dueMs);
+    ++circle->wavesEmitted;
+    
+    audioProcessor.addWaterImpulse({ static_cast<float>(circle->x - getWidth() / 2), static_cast<float>(circle->y - getHeight() / 2) }, 1.0f);
+    
+    const auto nextMs = dueMs + juce::jmax(1, circle->waveDistance) * 1000;
+    
+    if (nextMs < endMs)
+        waveEmissions.schedule(nextMs, serial);
+}
+
+void TekhneAudioProcessorEditor::updateWaterImage()
+{
+    auto& water = audioProcessor.getWater();
+    
+    if (! water.getLatestField(waterHeights, waterFrame))
+        return;
+    
+    const int size = water.getGridSize();
+    
+    if (waterImage.getWidth() != size)
+        waterImage = juce::Image(juce::Image::ARGB, size, size, true);
+    
+    // Crests light up, troughs go blue; flat water stays clear
+    juce::Image::BitmapData bitmap(waterImage, juce::Image::BitmapData::writeOnly);
+    
+    for (int y = 0; y < size; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            const float height = waterHeights[static_cast<size_t>(y * size + x)];
+            const float alpha = juce::jmin(1.0f, std::abs(height) * 4.0f) * 0.4f;
+            
+            bitmap.setPixelColour(x, y, (height > 0.0f ? juce::Colours::white : juce::Colours::steelblue).withAlpha(alpha));
+        }
     }
+}
 
-void TekhneAudioProcessorEditor::mouseDown(const juce::MouseEvent& event)
+void TekhneAudioProcessorEditor::updateAnalyser()
+{
+    auto& feed = audioProcessor.getAnalyserFeed();
+    
+    for (;;)
     {
+        const int numPeaks = feed.readPeaks(scopePeaks.data(), static_cast<int>(scopePeaks.size()));
+        
+        if (numPeaks == 0)
+            break;
+        
+        scopeView.addPeaks(scopePeaks.data(), numPeaks);
+    }
+    
+    if (feed.readSpectrumFrame(spectrumFrame.data()))
+        spectrumView.addFrame(spectrumFrame.data(), feed.getSampleRate());
+}
 
-    juce::Point<int> clickPosition = event.getPosition();
+void TekhneAudioProcessorEditor::findIntersections()
+{
+    const auto now = juce::Time::getCurrentTime();
     
-    int id;
+    // One radius per wave per frame, however many pairs it is in
+    std::pmr::vector<float> waveRadii(waves.size(), &frameArena);
     
-       if (!availableIDs.empty())
-       {
-           id = *availableIDs.begin();
-           availableIDs.erase(availableIDs.begin());
-       }
-       else
-       {
-           id = nextID++;  // Use the next new ID
-       }
+    for (size_t i = 0; i < waves.size(); ++i)
+        waveRadii[i] = calculateRadius(waves[i], now);
+    
+    intersectionBatch.clear();
+    
+    // Which two waves each pair is, in the order they were added
+    std::pmr::vector<Crossing> pairCrossings(&frameArena);
+    
+    for (size_t i = 0; i < waves.size(); ++i)
+    {
+        for (size_t j = i + 1; j < waves.size(); ++j)
+        {
+            if (waves[i].circleID == waves[j].circleID)
+                continue;
+            
+            intersectionBatch.addPair(static_cast<float>(waves[i].x), static_cast<float>(waves[i].y), waveRadii[i],
+                                      static_cast<float>(waves[j].x), static_cast<float>(waves[j].y), waveRadii[j]);
+            
+            Crossing crossing { waves[i].circleID, waves[i].sequence, waves[j].circleID, waves[j].sequence };
+            
+            if (crossing.circleB < crossing.circleA)
+                crossing = { crossing.circleB, crossing.sequenceB, crossing.circleA, crossing.sequenceA };
+            
+            pairCrossings.push_back(crossing);
+        }
+    }
+    
+    intersectionPairs.clear();
+    std::swap(crossings, previousCrossings);
+    crossings.clear();
+    
+    const auto& intersections = intersectionBatch.solve(*kernels);
+    std::pmr::vector<const CircleIntersectionBatch::Intersection*> newIntersections(&frameArena);
+    
+    for (const auto& intersection : intersections)
+    {
+        intersectionPairs.push_back({ intersection.x1, intersection.y1, intersection.x2, intersection.y2 });
+        
+        const auto& crossing = pairCrossings[static_cast<size_t>(intersection.pair)];
+        crossings.push_back(crossing);
+        
+        if (! std::binary_search(previousCrossings.begin(), previousCrossings.end(), crossing))
+            newIntersections.push_back(&intersection);
+    }
+    
+    std::sort(crossings.begin(), crossings.end());
+    
+    // One grain per new crossing, spread over the frame rather than all at once
+    const auto nowMs = juce::Time::getMillisecondCounterHiRes();
+    
+    for (size_t i = 0; i < newIntersections.size(); ++i)
+        triggerGrain(*newIntersections[i], nowMs + timerIntervalMs * static_cast<double>(i) / static_cast<double>(newIntersections.size()));
+    
+    // Crossings that carry on from last frame leave the carrier where it is
+    if (! newIntersections.empty())
+        postCrossingPitch(*newIntersections.back());
+}
+
+void TekhneAudioProcessorEditor::mouseDown(const juce::MouseEvent& event)
+    {
 
+    juce::Point<int> clickPosition = event.getPosition();
+    
     circles.push_back(Circle{
                             clickPosition.x,
                             clickPosition.y,
                             static_cast<int>(radiusSlider.getValue()),
                             static_cast<int>(growthSlider.getValue()),
                             static_cast<int>(waveDistance.getValue()),
-                            id,
+                            audioProcessor.allocateModulator(),
                             juce::Time::getCurrentTime()
                         }
     );
     
+    // The first wave leaves with the click, and the modulator starts with it
+    waveEmissions.schedule(circles.back().creationTime.toMilliseconds(), circles.back().serial);
+    sendModulatorParameters(circles.back());
+    
     erasingCircles();
 
     repaint();
     
 //    for (const auto& circle : circles)  // Iterate over each circle
 //        {
-//            DBG("Circle ID: " << circle.id);
+//            DBG("Circle modulator: " << circle.modulator.slot);
 //        }
 
 }
 
-bool TekhneAudioProcessorEditor::doCirclesIntersect(int x1, int y1, float r1, int x2, int y2, float r2) {
-    // Calculate the distance between the centers of the circles
-    float distance = std::sqrt(std::pow(x2 - x1, 2) + std::pow(y2 - y1, 2));
-
-    // Avoid issues with very small or negative radii
-    r1 = std::max(r1, 0.0f);
-    r2 = std::max(r2, 0.0f);
-
-    // Check for intersection
-    if (distance > r1 + r2) {
-        return false; // Circles are too far apart to intersect
-    } else if (distance < std::abs(r1 - r2)) {
-        return false; // One circle is completely inside the other without touching
-    } else {
-        return true; // Circles intersect or touch
-    }
-}
-
 void TekhneAudioProcessorEditor::paint(juce::Graphics& g)
 {
+    // Whatever paint() puts in the arena is gone when it returns
+    const FrameArena::ScopedRewind rewind(frameArena);
+    
     // Fill the background with a solid colour
     g.fillAll(getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId));
 
-    // Set the colour for the circles
-    g.setColour(getLookAndFeel().findColour(juce::Slider::thumbColourId));
-
-    setColour(juce::Slider::thumbColourId, juce::Colours::white);
-    setColour(juce::Slider::trackColourId, juce::Colours::white);
-
-//    bool newIntersectionFound = false;
+    if (waterImage.isValid())
+    {
+        const float pondRadius = TekhneAudioProcessor::pondRadius;
+        g.drawImage(waterImage, { getWidth() * 0.5f - pondRadius, getHeight() * 0.5f - pondRadius, pondRadius * 2.0f, pondRadius * 2.0f });
+    }
     
     g.setColour(juce::Colours::hotpink);
     g.fillEllipse(getWidth() / 2 - 4, getHeight() / 2 - 4, 8, 8);
     
+    waveLayer.clear();
 
-    for (int i = 0; i < circles.size(); ++i)
+    // Only draws; the circles' opacity and their modulators are kept up by update()
+    for (const auto& c1 : circles)
     {
-        Circle& c1 = circles[i];
         float c1Radius = c1.baseRadius;
         int c1Diameter = static_cast<int>(c1Radius * 2.0f);
+        
+        waveLayer.addEllipse({ c1.x - c1Radius, c1.y - c1Radius, static_cast<float>(c1Diameter), static_cast<float>(c1Diameter) },
+                             juce::Colours::white.withAlpha(c1.opacity));
+    }
+    
+    addWavesToLayer(juce::Time::getCurrentTime());
+    
+    waveLayer.render(getLocalBounds(), g.getInternalContext().getPhysicalPixelScaleFactor());
+    waveLayer.draw(g);
+    
+    g.setColour(juce::Colours::violet);
+    
+    for (const auto& intersection : intersectionPairs)
+    {
+        g.fillEllipse(intersection.x1 - 5, intersection.y1 - 5, 10, 10);
+        g.fillEllipse(intersection.x2 - 5, intersection.y2 - 5, 10, 10);
+    }
+}
 
-        float opacity = calculateOpacity(c1, decrementRate);
+void TekhneAudioProcessorEditor::addWavesToLayer(juce::Time now)
+{
+    const auto view = getLocalBounds().toFloat();
+    std::pmr::vector<VisibleRing> visibleRings(&frameArena);
+    visibleRings.reserve(waves.size());
+    
+    for (const auto& wave : waves)
+    {
+        const float radius = calculateRadius(wave, now);
+        const juce::Point<float> centre { static_cast<float>(wave.x), static_cast<float>(wave.y) };
         
-        g.setColour(juce::Colours::white.withAlpha(opacity));
-        g.fillEllipse(c1.x - c1Radius, c1.y - c1Radius, c1Diameter, c1Diameter);
+        // Only rings whose stroke crosses the view; the others can't put a pixel on it
+        const float nearX = juce::jlimit(view.getX(), view.getRight(), centre.x) - centre.x;
+        const float nearY = juce::jlimit(view.getY(), view.getBottom(), centre.y) - centre.y;
         
-        int s1 = (c1.x) - getWidth() / 2;
-        int s2 = (c1.y) - getHeight() / 2;
+        if (std::hypot(nearX, nearY) > radius + waveLineThickness || enclosesView(wave, radius))
+            continue;
         
-        distance_center = sqrt(pow(s1, 2) + pow(s2, 2));
-//        DBG(distance_center);
+        // Every other old ring fades out, halving the clutter where the rings are biggest
+        float alpha = 1.0f;
         
-        int modulationIndexID = c1.id;
+        if (wave.sequence % 2 == 1)
+        {
+            alpha = 1.0f - ((now - wave.creationTime).inSeconds() - thinningAge) / thinningFadeDuration;
+            
+            if (alpha <= 0.0f)
+                continue;
+            
+            alpha = juce::jmin(1.0f, alpha);
+        }
         
-        audioProcessor.setModulatorParameters(distance_center, modulationIndexID, c1.waveDistance);
+        visibleRings.push_back({ wave.x, wave.y, static_cast<int>(radius * 2.0f), radius, alpha });
     }
     
-    for (int i = 0; i < waves.size(); ++i)
+    // Rings that would land on the same pixels are stroked once, as strongly as the strongest of them
+    std::pmr::vector<int> ringOrder(visibleRings.size(), &frameArena);
+    std::iota(ringOrder.begin(), ringOrder.end(), 0);
+    
+    std::sort(ringOrder.begin(), ringOrder.end(), [&visibleRings](int a, int b)
     {
-        Wave& w1 = waves[i];
-
-        float w1Radius = calculateRadius(w1);
-        int w1Diameter = static_cast<int>(w1Radius * 2.0f);
-       
-        g.setColour(juce::Colours::white);
-        g.drawEllipse(w1.x - w1Radius, w1.y - w1Radius, w1Diameter, w1Diameter, 1.0f);
-        
-//        float expanded_r = w1.baseRadius + (w1.growthRate * fadeOutDuration);
-//        std::cout << "expanded_r: " << expanded_r << std::endl;
-//           std::cout << "w1.x - expanded_r: " << (w1.x - expanded_r) << std::endl;
-//           std::cout << "w1.x - w1Radius: " << (w1.x - w1.baseRadius) << std::endl;
+        const auto& ra = visibleRings[static_cast<size_t>(a)];
+        const auto& rb = visibleRings[static_cast<size_t>(b)];
+        return std::tie(ra.x, ra.y, ra.diameter, a) < std::tie(rb.x, rb.y, rb.diameter, b);
+    });
+    
+    for (size_t i = 1, first = 0; i < ringOrder.size(); ++i)
+    {
+        auto& kept = visibleRings[static_cast<size_t>(ringOrder[first])];
+        auto& ring = visibleRings[static_cast<size_t>(ringOrder[i])];
         
-//        for (int j = i + 1; j < waves.size(); ++j)
-//        {
-//            Wave& w2 = waves[i];
-//
-//            float w2Radius = calculateRadius(w2);
-//
-//            if (w1.circleID != w2.circleID)
-//            {
-//            if (doCirclesIntersect(w1.x, w1.y, w1Radius, w2.x, w2.y, w2Radius))
-//            {
-//                DBG("intersecting");
-//
-//                g.setColour(juce::Colours::violet);
-//                auto [ix1, iy1, ix2, iy2] = calculateIntersections(w1, w1Radius, w2, w2Radius);
-//                g.fillEllipse(ix1 - 5, iy1 - 5, 10, 10);
-//                g.fillEllipse(ix2 - 5, iy2 - 5, 10, 10);
-//
-//                IntersectionPair newIntersection{
-//                    roundToDecimalPlaces(ix1, 1),
-//                    roundToDecimalPlaces(iy1, 1),
-//                    roundToDecimalPlaces(ix2, 1),
-//                    roundToDecimalPlaces(iy2, 1)
-//                };
-//
-//                // Check if the intersection is new
-//                if (std::find(intersectionPairs.begin(), intersectionPairs.end(), newIntersection) == intersectionPairs.end())
-//                {
-//                    intersectionPairs.push_back(newIntersection);
-//                    newIntersectionFound = true;
-//                }
-//            }
-            }
+        if (ring.x == kept.x && ring.y == kept.y && ring.diameter == kept.diameter)
+        {
+            kept.alpha = juce::jmax(kept.alpha, ring.alpha);
+            ring.alpha = 0.0f;
         }
-//    }
-
-    // If a new intersection is found, update the frequency
-//    if (newIntersectionFound)
-//    {
-//        getIntersectionsX();
-//    }
+        else
+        {
+            first = i;
+        }
+    }
+    
+    for (const auto& ring : visibleRings)
+    {
+        if (ring.alpha <= 0.0f)
+            continue;
+        
+        const float diameter = static_cast<float>(ring.diameter);
+        waveLayer.addEllipse({ ring.x - ring.radius, ring.y - ring.radius, diameter, diameter },
+                             juce::Colours::white.withAlpha(ring.alpha), waveLineThickness);
+    }
+}
 
-//}
+bool TekhneAudioProcessorEditor::enclosesView(const Wave& wave, float radius) const
+{
+    const float farX = static_cast<float>(juce::jmax(std::abs(wave.x), std::abs(getWidth() - wave.x)));
+    const float farY = static_cast<float>(juce::jmax(std::abs(wave.y), std::abs(getHeight() - wave.y)));
+    
+    return radius - waveLineThickness > std::hypot(farX, farY);
+}
 
 void TekhneAudioProcessorEditor::resized()
 {
@@ -374,4 +590,13 @@ void TekhneAudioProcessorEditor::resized()
     carrierFreqLabel.setBounds(10, 65, 120, 20);
     waveDistanceLabel.setBounds(10, 25, 105, 20);
     
+   #if TEKHNE_PROFILING
+    cpuLoadLabel.setBounds(10, getHeight() - 30, getWidth() - 20, 20);
+   #endif
+    
+    // In the corners, where the pond doesn't reach
+    scopeView.setBounds(10, getHeight() - 100, 160, 60);
+    spectrumView.setBounds(getWidth() - 170, getHeight() - 100, 160, 60);
+    waveformPad.setBounds(getWidth() - 170, 10, 160, 60);
+    
 }
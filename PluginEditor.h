@@ -10,6 +10,12 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "CircleIntersections.h"
+#include "TimingWheel.h"
+#include "AnalyserViews.h"
+#include "WaveformPad.h"
+#include "TiledLayer.h"
+#include "FrameArena.h"
 
 //==============================================================================
 /**
@@ -31,12 +37,18 @@ public:
 
     void sliderValueChanged(juce::Slider* slider) override;
     
-    void getIntersectionsX();
+    // A crossing's pitch for the carrier; only new crossings send one, so the
+    // slider and the host can still move the carrier in between
+    void postCrossingPitch(const CircleIntersectionBatch::Intersection& intersection);
+    
+    // Where a crossing at x sits on the tuned pitch line, shared by the carrier and the grains
+    float getPitchAt(float x) const;
+    void triggerGrain(const CircleIntersectionBatch::Intersection& intersection, double timeMs);
     
     void mouseDown(const juce::MouseEvent& event) override;
     
     void erasingCircles();
-    bool doCirclesIntersect(int x1, int y1, float r1, int x2, int y2, float r2);
+    void updateCircles();
     
     void paint (juce::Graphics&) override;
     void resized() override;
@@ -59,18 +71,31 @@ private:
     juce::Label carrierFreqValueLabel;
 
 
+   #if TEKHNE_PROFILING
+    // Refreshed twice a second; setting a label's text allocates, and a
+    // figure that changes every tick can't be read anyway
+    juce::Label cpuLoadLabel;
+    void updateCpuLoadLabel();
+    static constexpr juce::uint32 cpuLoadLabelIntervalMs = 500;
+    juce::uint32 lastCpuLoadLabelMs = 0;
+   #endif
+    
+    // What the voice is playing, drained from the processor's feed every tick
+    ScopeView scopeView;
+    SpectrumView spectrumView;
+    WaveformPad waveformPad;    // draws the "Drawn" waveform
+    std::vector<AnalyserFeed::Peak> scopePeaks;
+    std::vector<float> spectrumFrame;
+    void updateAnalyser();
+
     juce::Slider modFreq;
     juce::Slider fmDepth;
     
     juce::Slider modFreq2;
     juce::Slider fmDepth2;
     
-    float distance_center;
     int waveLife;
     
-    std::set<int> availableIDs;  // Keeps track of available IDs for reuse
-    int nextID = 1;
-    
 //    const std::array<float, 128> midiNoteFrequencies = []{
 //        std::array<float, 128> frequencies = {};
 //        for (int i = 0; i < 128; ++i)
@@ -78,58 +103,16 @@ private:
 //        return frequencies;
 //    }();
     
-    float quantizeFrequency(float frequency)
-    {
-            auto closest = std::min_element(lydianScaleFrequencies.begin(), lydianScaleFrequencies.end(),
-                [frequency](float a, float b) {
-                    return std::abs(a - frequency) < std::abs(b - frequency);
-                });
-
-            return *closest;
-    }
-    
-    const std::array<float, 28> lydianScaleFrequencies = {
-        // Octave 3
-        130.81f, // C3 (Root)
-        146.83f, // D3 (Major Second)
-        164.81f, // E3 (Major Third)
-        185.00f, // F#3 (Augmented Fourth)
-        196.00f, // G3 (Perfect Fifth)
-        220.00f, // A3 (Major Sixth)
-        246.94f, // B3 (Major Seventh)
-
-        // Octave 4
-        261.63f, // C4 (Root)
-        293.66f, // D4 (Major Second)
-        329.63f, // E4 (Major Third)
-        369.99f, // F#4 (Augmented Fourth)
-        392.00f, // G4 (Perfect Fifth)
-        440.00f, // A4 (Major Sixth)
-        493.88f, // B4 (Major Seventh)
-
-        // Octave 5
-        523.25f, // C5 (Root)
-        587.33f, // D5 (Major Second)
-        659.26f, // E5 (Major Third)
-        739.99f, // F#5 (Augmented Fourth)
-        783.99f, // G5 (Perfect Fifth)
-        880.00f, // A5 (Major Sixth)
-        987.77f, // B5 (Major Seventh)
-
-        // Octave 6
-        1046.50f, // C6 (Root)
-        1174.66f, // D6 (Major Second)
-        1318.51f, // E6 (Major Third)
-        1479.98f, // F#6 (Augmented Fourth)
-        1567.98f, // G6 (Perfect Fifth)
-        1760.00f, // A6 (Major Sixth)
-        1975.53f  // B6 (Major Seventh)
-    };
     //-------------//
 
     void timerCallback() override
     {
+       #if TEKHNE_PROFILING
+        updateCpuLoadLabel();
+       #endif
         update();
+        updateAnalyser();
+        audioProcessor.updateHostWithGeneratedPitch();
     }
     
     
@@ -148,12 +131,18 @@ private:
             int baseRadius;
             int growthRate;
             int waveDistance;
-            int id;
+            TekhneAudioProcessor::ModulatorHandle modulator;     // invalid once every modulator is taken
         
             juce::Time creationTime;
             float opacity = 1;
+            int serial = generateUniqueId();    // never reused, unlike a modulator
+            int wavesEmitted = 0;
+            bool modulatorSent = false;         // its modulator has been told where it is
         };
     
+    // Each send restarts the modulator, so a circle only sends when it changes
+    void sendModulatorParameters(Circle& circle);
+    
     std::vector<Circle> circles;
     
     
@@ -164,6 +153,7 @@ private:
             int baseRadius;
             int growthRate;
             int circleID;
+            int sequence;       // how many waves its circle sent out before it
         
             juce::Time creationTime;
         
@@ -172,15 +162,53 @@ private:
                   y(circle.y),
                   baseRadius(circle.baseRadius),
                   growthRate(circle.growthRate),
-                  circleID(circle.id),
+                  circleID(circle.serial),
+                  sequence(circle.wavesEmitted),
                   creationTime(juce::Time::getCurrentTime())
             {}
         };
     
+    // Reserved up front for a busy pond, so a frame only allocates if the
+    // scene grows past anything it has held before
+    static constexpr size_t initialWaveCapacity = 512;
+    static constexpr size_t initialCrossingCapacity = 4096;
+    
     std::vector<Wave> waves;
     
+    // Waves are only stroked where they can be seen, and thinned out with age
+    struct VisibleRing
+        {
+            int x;
+            int y;
+            int diameter;
+            float radius;
+            float alpha;
+        };
+    
+    void addWavesToLayer(juce::Time now);
+    bool enclosesView(const Wave& wave, float radius) const;
+    
+    // Each live circle's next wave, keyed by Circle::serial. A wave is emitted
+    // exactly once per period and dated to when it was due, not when the
+    // timer got to it.
+    void emitWave(juce::int64 dueMs, int serial);
+    TimingWheel<int> waveEmissions;
+    
+    // Circles and waves, rasterised in parallel tiles and composited in paint()
+    TiledLayer waveLayer;
+    
+    // The processor's water surface, redrawn whenever it publishes a new frame
+    void updateWaterImage();
+    std::vector<float> waterHeights;
+    juce::uint32 waterFrame = 0;
+    juce::Image waterImage;
+    
     //------//
     
+    // Scratch space for one frame, rewound at the start of update(); declared
+    // before anything that keeps memory in it
+    FrameArena frameArena;
+    
    struct IntersectionPair
       {
           float x1;
@@ -194,7 +222,28 @@ private:
               }
       };
     
-    std::vector<IntersectionPair> intersectionPairs;
+    std::pmr::vector<IntersectionPair> intersectionPairs { &frameArena };  // where waves of different circles cross, this frame
+    
+    // A crossing is the same two waves meeting, whichever frame it's in. It
+    // sounds a grain in the frame it first appears and is quiet after that.
+    struct Crossing
+      {
+          int circleA, sequenceA;
+          int circleB, sequenceB;
+       
+          bool operator<(const Crossing& other) const
+              {
+                  return std::tie(circleA, sequenceA, circleB, sequenceB)
+                       < std::tie(other.circleA, other.sequenceA, other.circleB, other.sequenceB);
+              }
+      };
+    
+    std::vector<Crossing> crossings, previousCrossings;    // sorted; kept between frames
+    
+    // Every pair of waves from different circles is tested in one batch per frame
+    void findIntersections();
+    CircleIntersectionBatch intersectionBatch;
+    const DSPKernels* kernels = &DSPKernels::select();
 
     float roundToDecimalPlaces(float value, int decimalPlaces) {
         float factor = std::pow(10.0f, decimalPlaces);
@@ -203,11 +252,23 @@ private:
 
    float calculateRadius(const Wave& wave) const
        {
-           float elapsedTime = (juce::Time::getCurrentTime() - wave.creationTime).inSeconds();
+           return calculateRadius(wave, juce::Time::getCurrentTime());
+       }
+    
+   float calculateRadius(const Wave& wave, juce::Time now) const
+       {
+           float elapsedTime = (now - wave.creationTime).inSeconds();
            return wave.baseRadius + (elapsedTime * wave.growthRate);
        }
     
     
+    const float waveLineThickness = 1.0f;
+    const float thinningAge = 10.0f;            // seconds before every other wave starts to fade
+    const float thinningFadeDuration = 2.0f;
+    
+    const float grainReferenceRadius = 20.0f;  // crossings of waves this size or smaller play at full level
+    const float grainDurationMs = 80.0f;
+    
     const float fadeOutDuration = 20.0f;  // Duration in seconds (lifespan of the circle)
     const int timerIntervalMs = 60;  // Timer interval in milliseconds as set by startTimer(60)
     const int framesPerSecond = 1000 / timerIntervalMs;  // Calculate frames per second
@@ -228,23 +289,5 @@ private:
     }
 
     
-   std::tuple<float, float, float, float> calculateIntersections(const Wave& w1, float r1, const Wave& w2, float r2) const
-       {
-           float distance = std::sqrt(std::pow(w2.x - w1.x, 2) + std::pow(w2.y - w1.y, 2));
-           float a = (r1 * r1 - r2 * r2 + distance * distance) / (2 * distance);
-           float h = std::sqrt(r1 * r1 - a * a);
-
-           float dx = (w2.x - w1.x) / distance;
-           float dy = (w2.y - w1.y) / distance;
-
-           float ix1 = w1.x + a * dx + h * dy;
-           float iy1 = w1.y + a * dy - h * dx;
-           float ix2 = w1.x + a * dx - h * dy;
-           float iy2 = w1.y + a * dy + h * dx;
-
-           return { ix1, iy1, ix2, iy2 };
-       }
-
-
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TekhneAudioProcessorEditor)
 };
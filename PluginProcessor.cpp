@@ -21,49 +21,15 @@ TekhneAudioProcessor::TekhneAudioProcessor()
                        ), treeState(*this, nullptr, "PARAMETERS", createParameterLayout())
 #endif
 {
-    treeState.addParameterListener("frequency", this);
-    treeState.addParameterListener("modFreq", this);
-    treeState.addParameterListener("fmDepth", this);
-    treeState.addParameterListener("modFreq2", this);
-    treeState.addParameterListener("fmDepth2", this);
 }
 
 TekhneAudioProcessor::~TekhneAudioProcessor()
 {
-    treeState.removeParameterListener("frequency", this);
-    treeState.removeParameterListener("modFreq", this);
-    treeState.removeParameterListener("fmDepth", this);
-    treeState.removeParameterListener("modFreq2", this);
-    treeState.removeParameterListener("fmDepth2", this);
+    sharedImpulseResponse->release(impulseResponseReader);
     
-}
-
-void TekhneAudioProcessor::parameterChanged(const juce::String& parameterID, float newValue)
-{
-    if (parameterID == "frequency")
-    {
-//        osc.setFrequency(newValue);
-    }
-//    if (parameterID == "carrierFreq")
-//    {
-//        carrierOscillator.setFrequency(newValue);
-//    }
-    if (parameterID == "modFreq")
-    {
-//        modulatorOscillator.setFrequency(newValue);
-    }
-    if (parameterID == "fmDepth")
-    {
-        fmDepth = newValue;
-    }
-    if (parameterID == "modFreq2")
-    {
-//        modulatorOscillator2.setFrequency(newValue);
-    }
-    if (parameterID == "fmDepth2")
-    {
-        fmDepth2 = newValue;
-    }
+   #if TEKHNE_LATENCY_HISTOGRAMS
+    latencyReportWriter->removeMonitor(&latencyMonitor);
+   #endif
 }
 
 juce::AudioProcessorValueTreeState::ParameterLayout TekhneAudioProcessor::createParameterLayout()
@@ -90,70 +56,209 @@ juce::AudioProcessorValueTreeState::ParameterLayout TekhneAudioProcessor::create
 
     params.push_back(std::move(fmDepth2));
     
+    auto quantise = std::make_unique<juce::AudioParameterBool>((juce::ParameterID{"quantise", 1 }), "QUANTISE", false);
+
+    params.push_back(std::move(quantise));
+    
+    auto governor = std::make_unique<juce::AudioParameterBool>((juce::ParameterID{"governor", 1 }), "GOVERNOR", true);
+
+    params.push_back(std::move(governor));
+    
+    auto carrierWave = std::make_unique<juce::AudioParameterChoice>((juce::ParameterID{"carrierWave", 1 }), "CARRIERWAVE", getWaveformNames(), 0);
+
+    params.push_back(std::move(carrierWave));
+    
+    auto modulatorWave = std::make_unique<juce::AudioParameterChoice>((juce::ParameterID{"modulatorWave", 1 }), "MODULATORWAVE", getWaveformNames(), 0);
+
+    params.push_back(std::move(modulatorWave));
+    
+    juce::StringArray algorithmNames { "Pond" };
+    
+    for (const auto& algorithm : fmAlgorithms)
+        algorithmNames.add(algorithm.name);
+    
+    auto algorithm = std::make_unique<juce::AudioParameterChoice>((juce::ParameterID{"algorithm", 1 }), "ALGORITHM", algorithmNames, 0);
+
+    params.push_back(std::move(algorithm));
+    
+    auto feedback = std::make_unique<juce::AudioParameterFloat>((juce::ParameterID{"feedback", 1 }), "FEEDBACK", 0.0f, 1.5f, 0.0f);
+
+    params.push_back(std::move(feedback));
+    
+    auto reverb = std::make_unique<juce::AudioParameterFloat>((juce::ParameterID{"reverb", 1 }), "REVERB", 0.0f, 1.0f, 0.0f);
+
+    params.push_back(std::move(reverb));
+    
+    auto water = std::make_unique<juce::AudioParameterFloat>((juce::ParameterID{"water", 1 }), "WATER", 0.0f, 1.0f, 0.0f);
+
+    params.push_back(std::move(water));
+    
+    auto grains = std::make_unique<juce::AudioParameterFloat>((juce::ParameterID{"grains", 1 }), "GRAINS", 0.0f, 1.0f, 0.0f);
+
+    params.push_back(std::move(grains));
+    
+    auto recordPitch = std::make_unique<juce::AudioParameterBool>((juce::ParameterID{"recordPitch", 1 }), "RECORDPITCH", false);
+
+    params.push_back(std::move(recordPitch));
+    
     return { params.begin(), params.end() };
 }
 
 float TekhneAudioProcessor::calculateFunctionFmDepth(float x)
-    {
-        if (x <= 500.0f)
-            return 0.0f;
-        else
-        {
-            const float C = 14.f; // Calculated scaling factor
-            const float B = 0.005f; // Chosen growth rate
-            return static_cast<int>(C * (std::exp(B * (x - 500.0f)) - 1));
-        }
-    }
+{
+    return sharedTables->fmDepth(x);
+}
+
+juce::Result TekhneAudioProcessor::loadTuning(const juce::File& sclFile, double rootFrequency, int numPeriods)
+{
+    auto result = juce::Result::ok();
+
+    if (auto* tuning = sharedTables->getScalaTuning(sclFile, rootFrequency, numPeriods, result))
+        activeTuning.store(tuning);
+
+    return result;
+}
+
+void TekhneAudioProcessor::updateHostWithGeneratedPitch()
+{
+    float frequency = 0.0f;
+    
+    if (*treeState.getRawParameterValue("recordPitch") < 0.5f || ! pitchMailbox.takeForHost(frequency, hostPitchIntervalMs))
+        return;
+    
+    auto* parameter = treeState.getParameter("frequency");
+    const float normalised = parameter->convertTo0to1(frequency);
+    
+    recordedFrequency.store(parameter->convertFrom0to1(normalised));
+    
+    parameter->beginChangeGesture();
+    parameter->setValueNotifyingHost(normalised);
+    parameter->endChangeGesture();
+}
+
+void TekhneAudioProcessor::triggerGrain(const GrainEngine::Request& request)
+{
+    if (*treeState.getRawParameterValue("grains") <= 0.0f)
+        return;
+    
+    auto scaled = request;
+    scaled.gain *= grainLevel;
+    grains.trigger(scaled);
+}
+
+void TekhneAudioProcessor::setDrawnWaveform(const float* cycle, int numSamples)
+{
+    if (numSamples < 2)
+        return;
+    
+    auto table = MipmappedWavetable::createFromCycle(cycle, numSamples);
+    drawnWavetable.store(table.get());
+    
+    // From here on the audio thread can only pick up the new table, so of the
+    // two older ones, whichever it isn't marked as using can go
+    if (drawnWavetableInUse.load() != previousDrawnWavetable.get())
+        previousDrawnWavetable = std::move(drawnWavetableOwner);
+    
+    drawnWavetableOwner = std::move(table);
+}
+
+const MipmappedWavetable* TekhneAudioProcessor::acquireDrawnWavetable() noexcept
+{
+    return acquireHazardPointer(drawnWavetable, drawnWavetableInUse);
+}
+
+const MipmappedWavetable* TekhneAudioProcessor::getWavetable(juce::StringRef parameterID, const MipmappedWavetable* drawn) const noexcept
+{
+    const auto waveform = static_cast<Waveform>(juce::roundToInt(*treeState.getRawParameterValue(parameterID)));
+    
+    if (waveform == Waveform::drawn)
+        return drawn; // a plain sine until something has been drawn
+    
+    return sharedTables->getWavetable(waveform);
+}
 
-void TekhneAudioProcessor::setModulatorParameters(float newDistance, int modulationIndexID, int waveLife)
+bool TekhneAudioProcessor::setModulatorParameters(juce::Point<float> offsetFromCentre, ModulatorHandle modulator, int waveLife)
 {
+    if (! modulatorSlots.isLive(modulator))
+        return true;
     
     float frequencyValue = juce::jmap(static_cast<float>(waveLife), 2.0f, 9.0f, 2000.0f, 5.0f);
     
-    distance_center = newDistance;
+    float distance_center = offsetFromCentre.getDistanceFromOrigin();
     
     float maxScaledDistance = 1000.0f;
-    float scaling_ratio = maxScaledDistance / 350;
-    scaled_distance = distance_center * scaling_ratio;
-    
-    modulationTarget = 1000.f;
+    float scaling_ratio = maxScaledDistance / pondRadius;
+    float scaled_distance = distance_center * scaling_ratio;
     
     const float maxRampTime = 10.0f;
-    rampTime = maxRampTime * (scaled_distance / maxScaledDistance);
+    float rampTime = maxRampTime * (scaled_distance / maxScaledDistance);
     
     double rampSamples = getSampleRate() * rampTime;
 
-    modulationIncrement = modulationTarget / rampSamples;
-    
-    switch (modulationIndexID) {
-            case 1:
-                freq_modulator = frequencyValue;
-                modulationIncrement1 = modulationIncrement;
-                rampTime1 = rampTime;
-                modulationCompleted = false;
-                break;
-            case 2:
-                freq_modulator2 = frequencyValue;
-                modulationIncrement2 = modulationIncrement;
-                rampTime2 = rampTime;
-                modulationCompleted2 = false;
-                break;
-            case 3:
-                freq_modulator3 = frequencyValue;
-                modulationIncrement3 = modulationIncrement;
-                rampTime3 = rampTime;
-                modulationCompleted3 = false;
-                break;
-            case 4:
-                freq_modulator4 = frequencyValue;
-                modulationIncrement3 = modulationIncrement;
-                rampTime4 = rampTime;
-                modulationCompleted4 = false;
-                break;
-            default:
-                DBG("Invalid modulationIndexID: " << modulationIndexID);
-                break;
-        }
+    float modulationIncrement = modulationTarget / rampSamples;
+    
+    // The audio thread owns all modulator state; it picks this up at the start
+    // of its next block. If the queue is full the update is dropped, and the
+    // caller tries again later.
+    return modulatorCommands.push({ modulator, frequencyValue, modulationIncrement, offsetFromCentre / pondRadius });
+}
+
+void TekhneAudioProcessor::applyModulatorCommands()
+{
+    modulatorCommands.popAll([this](const ModulatorCommand& command)
+    {
+        // Queued before its slot was reclaimed; the slot may belong to another circle now
+        if (! modulatorSlots.isCurrent(command.modulator))
+            return;
+        
+        const int modulationIndexID = command.modulator.slot + 1;
+        
+        applyModulatorCommand(floatEngine, modulationIndexID, command.frequency, command.increment);
+        applyModulatorCommand(doubleEngine, modulationIndexID, command.frequency, command.increment);
+        
+        modulatorPositions[static_cast<size_t>(command.modulator.slot)] = command.position;
+        water.setProbePosition(command.modulator.slot, command.position);
+    });
+}
+
+template <typename SampleType>
+void TekhneAudioProcessor::applyModulatorCommand(FMEngine<SampleType, numModulators>& engine, int modulationIndexID,
+                                                 float frequency, float increment)
+{
+    jassert(modulationIndexID >= 1 && modulationIndexID <= numModulators); // slots map one to one onto modulators
+    
+    const auto step = static_cast<SampleType>(increment);
+    
+    engine.setRampIncrements(modulationIndexID - 1, step, step);
+    engine.startModulator(modulationIndexID - 1, static_cast<SampleType>(frequency));
+}
+
+template <typename SampleType>
+void TekhneAudioProcessor::reclaimModulators(const FMEngine<SampleType, numModulators>& engine)
+{
+    // A released modulator is only handed out again once its ramp has run
+    // out, so a new circle never picks one up halfway through
+    for (int m = 0; m < numModulators; ++m)
+        if (modulatorSlots.isReleasing(m) && engine.isModulatorAtRest(m))
+            modulatorSlots.reclaim(m);
+}
+
+template <typename SampleType>
+juce::Point<float> TekhneAudioProcessor::getVoicePosition(const FMEngine<SampleType, numModulators>& engine) const noexcept
+{
+    // The voice sits where the modulators bending it are, weighted by how far
+    // each one's ramp has got; with nothing ramping it's in the middle.
+    juce::Point<float> position;
+    float totalWeight = 0.0f;
+    
+    for (int m = 0; m < numModulators; ++m)
+    {
+        const auto weight = static_cast<float>(engine.getModulationIndex(m));
+        position += modulatorPositions[static_cast<size_t>(m)] * weight;
+        totalWeight += weight;
+    }
+    
+    return totalWeight > 0.0f ? position / totalWeight : juce::Point<float>();
 }
 
 //==============================================================================
@@ -191,7 +296,9 @@ bool TekhneAudioProcessor::isMidiEffect() const
 
 double TekhneAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    // The carrier never stops, whatever comes in, so hosts must keep calling
+    // processBlock; idle instances are made cheap by the engine instead.
+    return std::numeric_limits<double>::infinity();
 }
 
 int TekhneAudioProcessor::getNumPrograms()
@@ -226,24 +333,56 @@ void TekhneAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock
     spec.sampleRate = sampleRate;
     spec.numChannels = getTotalNumOutputChannels();
     
-//    updateAngleDelta();
     freq_carrier = *treeState.getRawParameterValue("frequency");
+    lastParameterFrequency = freq_carrier;
     
     gain.prepare(spec);
-    gain.setGainLinear(0.01f);
+    gain.setRampDurationSeconds(0.05);
+    gain.setGainLinear(*treeState.getRawParameterValue("reverb"));
+    gain.reset();
     
-//    modulationIndex = distance_center;
-
-//    lastFreq = *treeState.getRawParameterValue("frequency");
-//    osc.setFrequency(*treeState.getRawParameterValue("frequency") + fmDepth);
-//
-//    modulatorOscillator.setFrequency(*treeState.getRawParameterValue("modFreq")
-//                                     );
+    grainGain.prepare(spec);
+    grainGain.setRampDurationSeconds(0.05);
+    grainGain.setGainLinear(*treeState.getRawParameterValue("grains"));
+    grainGain.reset();
+    
+    grains.prepare(sampleRate);
+    grainBuffer.setSize(1, samplesPerBlock);
+    
+    reverb.prepare(sampleRate);
+    reverbBuffer.setSize(1, samplesPerBlock);
+    reverbRunning = false;
+    sharedImpulseResponse->prepare(impulseResponseReader, sampleRate);
+    
+    floatEngine.prepare(sampleRate, samplesPerBlock);
+    doubleEngine.prepare(sampleRate, samplesPerBlock);
+    floatOscillator.prepare(sampleRate, samplesPerBlock);
+    doubleOscillator.prepare(sampleRate, samplesPerBlock);
+    panner.prepare(getChannelLayoutOfBus(false, 0));
+    water.start();
+    governor.prepare(sampleRate);
+    appliedQualityLevel = -1;
+    analyserFeed.prepare(sampleRate);
+    
+   #if TEKHNE_PROFILING
+    profiler.prepare(sampleRate, samplesPerBlock);
+   #endif
+    
+   #if TEKHNE_LATENCY_HISTOGRAMS
+    latencyMonitor.prepare(sampleRate, samplesPerBlock);
+    latencyReportWriter->addMonitor(&latencyMonitor, getName());   // only reported once it plays
+   #endif
 }
 
 void TekhneAudioProcessor::releaseResources()
 {
     // Free up any resources when playback stops
+    water.stop();
+    sharedImpulseResponse->release(impulseResponseReader);
+    
+    // No audio thread is left to see released modulators wind down
+    for (int m = 0; m < numModulators; ++m)
+        modulatorSlots.reclaim(m);
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -253,8 +392,7 @@ bool TekhneAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) c
     juce::ignoreUnused (layouts);
     return true;
   #else
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    if (! SpatialPanner::isLayoutSupported(layouts.getMainOutputChannelSet()))
         return false;
 
    #if ! JucePlugin_IsSynth
@@ -268,233 +406,250 @@ bool TekhneAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) c
 #endif
 
 void TekhneAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    processBlockWithEngine(buffer, floatEngine, floatOscillator);
+}
+
+void TekhneAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    processBlockWithEngine(buffer, doubleEngine, doubleOscillator);
+}
+
+template <typename SampleType>
+void TekhneAudioProcessor::processBlockWithEngine(juce::AudioBuffer<SampleType>& buffer, FMEngine<SampleType, numModulators>& engine,
+                                                  FMOscillator<SampleType>& oscillator)
     {
+        TEKHNE_REALTIME_SECTION;
+        TEKHNE_RECORD_BLOCK_LATENCY(latencyMonitor);
+        TEKHNE_PROFILE_BLOCK(profiler, buffer.getNumSamples());
+    
+        const auto blockStartTicks = juce::Time::getHighResolutionTicks();
+        const auto blockStartMs = juce::Time::getMillisecondCounterHiRes();
+    
+        applyModulatorCommands();
+        reclaimModulators(engine);
+        applyQualityLevel(engine);
+        applyWaterDepths(engine);
     
-    // ScopedNoDenormals noDenormals;
         auto totalNumInputChannels  = getTotalNumInputChannels();
         auto totalNumOutputChannels = getTotalNumOutputChannels();
     
-        freq_carrier = *treeState.getRawParameterValue("frequency");
-        auto cyclesPerSample = freq_carrier / getSampleRate();
-        incr_carrier = cyclesPerSample * juce::MathConstants<double>::pi;
+        const float parameterFrequency = *treeState.getRawParameterValue("frequency");
+        float generatedFrequency = 0.0f;
     
-        auto cyclesPerSample_mod = freq_modulator / getSampleRate();
-        incr_modulator = cyclesPerSample_mod * juce::MathConstants<double>::pi;
-
-        auto cyclesPerSample_mod2 = freq_modulator2 / getSampleRate();
-        incr_modulator2 = cyclesPerSample_mod2 * juce::MathConstants<double>::pi;
+        if (pitchMailbox.fetch(generatedFrequency))
+            freq_carrier = generatedFrequency;
+        else if (parameterFrequency != lastParameterFrequency && parameterFrequency != recordedFrequency.load())
+            freq_carrier = parameterFrequency;
     
-        auto cyclesPerSample_mod3 = freq_modulator3 / getSampleRate();
-        incr_modulator3 = cyclesPerSample_mod3 * juce::MathConstants<double>::pi;
+        lastParameterFrequency = parameterFrequency;
     
-        auto cyclesPerSample_mod4 = freq_modulator4 / getSampleRate();
-        incr_modulator4 = cyclesPerSample_mod4 * juce::MathConstants<double>::pi;
-
+        const SharedDSPTables& tables = *sharedTables;
+        const bool quantiseCarrier = *treeState.getRawParameterValue("quantise") > 0.5f;
+        const Tuning* quantiseTo = quantiseCarrier ? activeTuning.load() : nullptr;
+        
+        const auto* drawn = acquireDrawnWavetable();   // the same table for both, all block
+        engine.setWavetables(getWavetable("carrierWave", drawn), getWavetable("modulatorWave", drawn));
+        
+        gain.setGainLinear(*treeState.getRawParameterValue("reverb"));
+        grainGain.setGainLinear(*treeState.getRawParameterValue("grains"));
+        
+        // Silent grains are dropped rather than rendered
+        grainsAudible = grainGain.getGainLinear() > 0.0f || grainGain.isSmoothing();
+        grains.beginBlock(blockStartMs, grainsAudible);
+        
+        const int algorithm = juce::roundToInt(*treeState.getRawParameterValue("algorithm")) - 1;
+        
+        if (algorithm >= 0)
+            applyAlgorithm(oscillator, engine, algorithm, static_cast<SampleType>(quantiseTo != nullptr ? quantiseTo->quantise(freq_carrier)
+                                                                                                      : freq_carrier));
         
         for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         {
            buffer.clear(i, 0, buffer.getNumSamples());
         }
-            
-            int numChannels = buffer.getNumChannels();
     
-            DBG("Completed: " + juce::String(modulationCompleted ? "true" : "false"));
-            DBG("Completed2: " + juce::String(modulationCompleted2 ? "true" : "false"));
-         
-            for (auto sample = 0; sample < buffer.getNumSamples(); sample++)
+        // Each stage runs over a whole chunk before the next one starts, so the
+        // inner loops stay small and every stage can be timed on its own.
+        const int chunkSize = engine.getMaximumBlockSize();
+        jassert(chunkSize > 0); // prepareToPlay hasn't been called
+    
+        if (chunkSize == 0)
+            return;
+    
+        for (int start = 0; start < buffer.getNumSamples(); start += chunkSize)
+        {
+            const int numSamples = juce::jmin(chunkSize, buffer.getNumSamples() - start);
+    
+            // With every ramp parked at zero nothing bends the carrier, so a
+            // dormant instance only pays for one sine
+            if (algorithm >= 0)
             {
-               
-                if (!modulationCompleted) {
-                    if (increasing1) {
-                        modulationIndex += modulationIncrement;
-
-                        if (modulationIndex >= modulationTarget) {
-                            modulationIndex = modulationTarget;
-                            increasing1 = false;
-                        }
-                    } else {
-                        modulationIndex -= modulationIncrement;
-
-                        if (modulationIndex <= modulationStart) {
-                            modulationIndex = modulationStart;
-                            increasing1 = true;
-                            modulationCompleted = true;
-                        }
-                    }
-                }
-                
-                if (!modulationCompleted2) {
-                    if (increasing2) {
-                        modulationIndex2 += modulationIncrement2;
-                        if (modulationIndex2 >= modulationTarget) {
-                            modulationIndex2 = modulationTarget;
-                            increasing2 = false;
-                        }
-                    } else {
-                        modulationIndex2 -= modulationIncrement2;
-
-                        if (modulationIndex2 <= modulationStart) {
-                            modulationIndex2 = modulationStart;
-                            increasing2 = true;
-                            modulationCompleted2 = true;
-                        }
-                    }
-                }
-                
-                if (!modulationCompleted3) {
-                    if (increasing3) {
-                        modulationIndex3 += modulationIncrement3;
-
-                        if (modulationIndex3 >= modulationTarget) {
-                            modulationIndex3 = modulationTarget;
-                            increasing3 = false;
-                        }
-                    } else {
-                        modulationIndex3 -= modulationIncrement3;
-
-                        if (modulationIndex3 <= modulationStart)
-                        {
-                            modulationIndex3 = modulationStart;
-                            increasing3 = true;
-                            modulationCompleted3 = true;
-                        }
-                    }
-                }
-                
-                if (!modulationCompleted4) {
-                    if (increasing4) {
-                        modulationIndex4 += modulationIncrement4;
-
-                        if (modulationIndex4 >= modulationTarget)
-                        {
-                            modulationIndex4 = modulationTarget;
-                            increasing4 = false;
-                        }
-                    } else {
-                        modulationIndex4 -= modulationIncrement2;
-
-                        if (modulationIndex4 <= modulationStart)
-                        {
-                            modulationIndex4 = modulationStart;
-                            increasing4 = true;
-                            modulationCompleted4 = true;
-                        }
-                    }
-                }
-                
-                double modulatorSignal = std::sin(phase_modulator);
-                phase_modulator += incr_modulator;
-                
-                if (phase_modulator >= two_pi)
                 {
-                    phase_modulator -= two_pi;
+                    // Scaled as the engine would play them, so the governor's fades and the water still apply
+                    TEKHNE_PROFILE_STAGE(profiler, DSPStage::ramps);
+                    engine.renderRamps(numSamples);
+                    engine.renderScaledRamps(numSamples);
                 }
-                
-                double modulatorSignal2 = std::sin(phase_modulator2);
-                phase_modulator2 += incr_modulator2;
-                
-                if (phase_modulator2 >= two_pi)
                 {
-                    phase_modulator2 -= two_pi;
+                    // Feedback keeps even a lone operator busy, so there is no idle shortcut here
+                    TEKHNE_PROFILE_STAGE(profiler, DSPStage::carrier);
+                    oscillator.render({ nullptr, engine.getScaledRamp(0), engine.getScaledRamp(1), engine.getScaledRamp(2), engine.getScaledRamp(3) },
+                                      numSamples, tables);
                 }
-                
-                double modulatorSignal3 = std::sin(phase_modulator3);
-                phase_modulator3 += incr_modulator3;
-                
-                if (phase_modulator3 >= two_pi)
+            }
+            else if (engine.isIdle())
+            {
+                TEKHNE_PROFILE_STAGE(profiler, DSPStage::carrier);
+                engine.renderIdle(numSamples, static_cast<SampleType>(freq_carrier), tables, quantiseTo);
+            }
+            else
+            {
                 {
-                    phase_modulator3 -= two_pi;
+                    TEKHNE_PROFILE_STAGE(profiler, DSPStage::ramps);
+                    engine.renderRamps(numSamples);
                 }
-                
-                double modulatorSignal4 = std::sin(phase_modulator4);
-                phase_modulator4 += incr_modulator4;
-                
-                if (phase_modulator4 >= two_pi)
                 {
-                    phase_modulator4 -= two_pi;
+                    TEKHNE_PROFILE_STAGE(profiler, DSPStage::modulators);
+                    engine.renderModulators(numSamples, static_cast<SampleType>(freq_carrier), tables);
                 }
-                
-                double modulatedFreq = freq_carrier +
-                                       modulationIndex * modulatorSignal +
-                                       modulationIndex2 * modulatorSignal2 +
-                                       modulationIndex3 * modulatorSignal3 +
-                                       modulationIndex4 * modulatorSignal4;
-                
-                auto cyclesPerSample_modulated = modulatedFreq / getSampleRate();
-                double incr_carrier_modulated = cyclesPerSample_modulated * juce::MathConstants<double>::pi * 2.0;
-                
-                phase_carrier += incr_carrier_modulated;
-                
-                if (phase_carrier >= two_pi)
                 {
-                    phase_carrier -= two_pi;
+                    TEKHNE_PROFILE_STAGE(profiler, DSPStage::carrier);
+                    engine.renderCarrier(numSamples, tables, quantiseTo);
                 }
-                
-                float output = (float) (std::sin(phase_carrier)) * 0.5f;
-
-                
-                   for (int channel = 0; channel < numChannels; ++channel)
-                   {
-                       // Get write pointer for the current channel
-                       auto* channelData = buffer.getWritePointer(channel);
-                       // Assign the signal value to the current sample
-                       channelData[sample] = output;
-                   }
             }
+    
+            const SampleType* voice = algorithm >= 0 ? oscillator.getOutput() : engine.getOutput();
+            
+            {
+                TEKHNE_PROFILE_STAGE(profiler, DSPStage::output);
+                panner.setPosition(getVoicePosition(engine));
+                panner.render(buffer, start, voice, numSamples);
+                analyserFeed.push(voice, numSamples);
+            }
+            
+            {
+                TEKHNE_PROFILE_STAGE(profiler, DSPStage::reverb);
+                renderReverb(buffer, start, voice, numSamples);
+            }
+            
+            TEKHNE_PROFILE_STAGE(profiler, DSPStage::grains);
+            renderGrains(buffer, start, numSamples);
+        }
+    
+        governor.addBlock(juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - blockStartTicks),
+                          buffer.getNumSamples());
+    }
+
+template <typename SampleType>
+void TekhneAudioProcessor::applyAlgorithm(FMOscillator<SampleType>& oscillator, const FMEngine<SampleType, numModulators>& engine,
+                                          int algorithm, SampleType carrierFrequency)
+{
+    static_assert(FMOscillator<SampleType>::numOperators == numModulators + 1, "one operator per modulator, plus the carrier");
+    
+    const auto& routing = fmAlgorithms[static_cast<size_t>(algorithm)];
+    const float feedback = *treeState.getRawParameterValue("feedback");
+    
+    // A full ramp is worth pi radians of modulation. Carriers share the
+    // engine's 0.5 output level, and the ramped ones swell with their circles.
+    const SampleType radiansPerRamp = juce::MathConstants<SampleType>::pi / static_cast<SampleType>(modulationTarget);
+    const SampleType carrierLevel = static_cast<SampleType>(0.5) / static_cast<SampleType>(routing.getNumCarriers());
+    
+    oscillator.setAlgorithm(algorithm);
+    
+    for (int op = 0; op < FMOscillator<SampleType>::numOperators; ++op)
+    {
+        const SampleType rampScale = op == 0 ? static_cast<SampleType>(1) : static_cast<SampleType>(1) / static_cast<SampleType>(modulationTarget);
         
+        oscillator.setFrequency(op, op == 0 ? carrierFrequency : engine.getModulatorFrequency(op - 1));
+        oscillator.setScale(op, routing.isCarrier(op) ? carrierLevel * rampScale : radiansPerRamp);
+        oscillator.setFeedback(op, static_cast<SampleType>(op == routing.feedbackOperator ? feedback : 0.0f));
+        oscillator.setWavetable(op, op == 0 ? engine.getCarrierWavetable() : engine.getModulatorWavetable());
     }
+}
+
+template <typename SampleType>
+void TekhneAudioProcessor::renderReverb(juce::AudioBuffer<SampleType>& buffer, int startSample, const SampleType* voice, int numSamples)
+{
+    const auto* response = sharedImpulseResponse->get(impulseResponseReader);
     
-//    juce::ScopedNoDenormals noDenormals;
-//    auto totalNumInputChannels = getTotalNumInputChannels();
-//    auto totalNumOutputChannels = getTotalNumOutputChannels();
-//
-//    for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
-//    {
-//        buffer.clear(i, 0, buffer.getNumSamples());
-//    }
-//
-//    juce::dsp::AudioBlock<float> audioBlock { buffer };
-//
-//
-//    for (int ch = 0; ch < audioBlock.getNumChannels(); ++ch)
-//    {
-//        for (int s = 0; s < audioBlock.getNumSamples(); ++s)
-//        {
-//
-//            freq_carrier = *treeState.getRawParameterValue("modFreq");;
-//            incr_carrier = freq_carrier * 0.00013f;//two_pi * freq_carrier / getSampleRate();
-//
-//            phase_carrier += incr_carrier;
-//
-//            if(phase_carrier >= two_pi)
-//            {
-//                phase_carrier -= two_pi;
-//            }
-//
-//            out_carrier = std::sin(phase_carrier);
-//
-//            buffer.setSample(ch, s, out_carrier);
-            
-//            float fmMod = modulatorOscillator.processSample(audioBlock.getSample(ch, s)) * fmDepth;
-//
-//            float modFreq = *treeState.getRawParameterValue("modFreq");
-//            modulatorOscillator.setFrequency(modFreq);  // Set the modulator oscillator's frequency
-//
-//            float modulatedFrequency = *treeState.getRawParameterValue("frequency") + fmMod;
-//            modulatedFrequency = std::abs(modulatedFrequency);
-//
-//
-//            float quantizedModulatedFreq = quantizeFrequency(modulatedFrequency);
-//            osc.setFrequency(modulatedFrequency);
+    // Nothing to hear until the shared response is built or while fully dry
+    if (response == nullptr || (gain.getGainLinear() == 0.0f && ! gain.isSmoothing()))
+    {
+        reverbRunning = false;
+        return;
+    }
+    
+    // Start from silence rather than whatever was left when it went dry
+    if (! reverbRunning)
+    {
+        reverb.reset();
+        reverbRunning = true;
+    }
+    
+    auto* wet = reverbBuffer.getWritePointer(0);
+    
+    if constexpr (std::is_same_v<SampleType, float>)
+    {
+        reverb.process(voice, wet, numSamples, *response);
+    }
+    else
+    {
+        for (int sample = 0; sample < numSamples; ++sample)
+            wet[sample] = static_cast<float>(voice[sample]);
         
+        reverb.process(wet, wet, numSamples, *response);
+    }
+    
+    auto block = juce::dsp::AudioBlock<float>(reverbBuffer).getSubBlock(0, static_cast<size_t>(numSamples));
+    gain.process(juce::dsp::ProcessContextReplacing<float>(block));
+    
+    panner.renderDiffuse(buffer, startSample, wet, numSamples);
+}
 
-//    }
+template <typename SampleType>
+void TekhneAudioProcessor::renderGrains(juce::AudioBuffer<SampleType>& buffer, int startSample, int numSamples)
+{
+    if (! grainsAudible)
+        return;
+    
+    auto* output = grainBuffer.getWritePointer(0);
+    grains.render(output, numSamples, *sharedTables);
+    
+    auto block = juce::dsp::AudioBlock<float>(grainBuffer).getSubBlock(0, static_cast<size_t>(numSamples));
+    grainGain.process(juce::dsp::ProcessContextReplacing<float>(block));
+    
+    panner.renderDiffuse(buffer, startSample, output, numSamples);
+}
 
-//    modulatorOscillator.process(juce::dsp::ProcessContextReplacing<float>(audioBlock));
-//    osc.process(juce::dsp::ProcessContextReplacing<float>(audioBlock));
-    //gain.process(juce::dsp::ProcessContextReplacing<float>(audioBlock));
+template <typename SampleType>
+void TekhneAudioProcessor::applyQualityLevel(FMEngine<SampleType, numModulators>& engine)
+{
+    const int level = *treeState.getRawParameterValue("governor") > 0.5f ? governor.getLevel() : 0;
     
-//}
+    // Each level sheds one modulator, keeping the deepest. The engine fades
+    // them over 50 ms, and re-picks every block so the choice follows the ramps.
+    if (level == 0 && appliedQualityLevel == 0)
+        return;
+    
+    const int fadeSamples = static_cast<int>(getSampleRate() * 0.05);
+    engine.setMaxActiveModulators(juce::jmax(1, numModulators - level), fadeSamples);
+    appliedQualityLevel = level;
+}
+
+template <typename SampleType>
+void TekhneAudioProcessor::applyWaterDepths(FMEngine<SampleType, numModulators>& engine)
+{
+    const float amount = *treeState.getRawParameterValue("water");
+    
+    // A crest under a circle deepens its modulator and a trough thins it,
+    // glided over the block. With no water every depth is exactly 1.
+    for (int m = 0; m < numModulators; ++m)
+    {
+        const float depth = 1.0f + amount * waterDepthPerHeight * water.getProbeHeight(m);
+        engine.setModulatorDepth(m, static_cast<SampleType>(juce::jlimit(0.0f, 2.0f, depth)));
+    }
+}
 
 
 //==============================================================================
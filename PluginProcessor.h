@@ -9,12 +9,27 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "SharedDSPTables.h"
+#include "FMEngine.h"
+#include "FMosc.h"
+#include "SpatialPanner.h"
+#include "ConvolutionReverb.h"
+#include "WaterSimulation.h"
+#include "GrainEngine.h"
+#include "AnalyserFeed.h"
+#include "QualityGovernor.h"
+#include "PitchMailbox.h"
+#include "SlotAllocator.h"
+#include "MultiProducerQueue.h"
+#include "HazardPointer.h"
+#include "DSPProfiler.h"
+#include "LatencyHistogram.h"
+#include "RealtimeSafety.h"
 
 //==============================================================================
 /**
 */
-class TekhneAudioProcessor  : public juce::AudioProcessor,
-                              public juce::AudioProcessorValueTreeState::Listener
+class TekhneAudioProcessor  : public juce::AudioProcessor
 {
 public:
     //==============================================================================
@@ -30,6 +45,8 @@ public:
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override { return true; }
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -53,149 +70,200 @@ public:
     //==============================================================================
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
-    
-//    void getNextAudioBlock (const juce::AudioSourceChannelInfo& bufferToFill) override;
 
     juce::AudioProcessorValueTreeState treeState;
-    void parameterChanged(const juce::String& parameterID, float newValue) override;
     
-    void setModulatorParameters(float newDistance, int modulationIndexID, int waveLife);
+    /** One modulator, claimed by a circle for as long as it lives. */
+    using ModulatorHandle = SlotHandle;
+    
+    /** Any thread: a free modulator, or an invalid handle while all of them are
+        taken or still winding down from their last circle.
+    */
+    ModulatorHandle allocateModulator() noexcept { return modulatorSlots.allocate(); }
+    
+    /** Any thread: the circle has gone. Its modulator ramps out and is reused
+        once the audio thread sees it at rest; the handle is dead from now on.
+    */
+    void releaseModulator(ModulatorHandle modulator) noexcept { modulatorSlots.release(modulator); }
+    
+    /** Safe to call from any non-audio thread; the change is queued for the audio thread.
+        offsetFromCentre is the circle's position relative to the middle of the pond, in pixels.
+        Each call restarts the modulator's ramp, so only call it when the circle changes.
+        Ignored unless the handle is live. Returns false if the queue was full
+        and the change was dropped.
+    */
+    bool setModulatorParameters(juce::Point<float> offsetFromCentre, ModulatorHandle modulator, int waveLife);
     float calculateFunctionFmDepth(float x);
     
-    void setModulatorFrequency(float freq);
+    /** Any thread: a pitch from the pond for the carrier. It reaches the audio
+        thread without touching the "frequency" parameter.
+    */
+    void postGeneratedPitch(float frequency) noexcept { pitchMailbox.post(frequency); }
+    
+    /** Message thread, from a timer: if "recordPitch" is on, writes the newest
+        generated pitch to the "frequency" parameter, at most once per
+        hostPitchIntervalMs, so the host can record it as automation.
+    */
+    void updateHostWithGeneratedPitch();
+    
+    /** The scale the carrier and the editor's pitch mapping snap to. */
+    const Tuning& getTuning() const noexcept { return *activeTuning.load(); }
+    juce::Result loadTuning(const juce::File& sclFile, double rootFrequency, int numPeriods);
+    
+   #if TEKHNE_PROFILING
+    DSPProfiler& getProfiler() noexcept { return profiler; }
+   #endif
+    
+    /** Message thread: makes a drawn single cycle the "Drawn" waveform.
+        Building the table is costly, so call it on mouse-up rather than on
+        every drag.
+    */
+    void setDrawnWaveform(const float* cycle, int numSamples);
+    
+    /** Replaces the reverb response of every instance; the file is read in the background. */
+    juce::Result loadImpulseResponse(const juce::File& file) { return sharedImpulseResponse->load(file); }
+    
+    /** Editor pixels from the middle of the pond to its edge. */
+    static constexpr float pondRadius = 350.0f;
+    
+    /** The pond's surface. The processor runs it while prepared and listens to
+        it at the modulators' positions; the editor drops waves in and draws it.
+    */
+    WaterSimulation& getWater() noexcept { return water; }
+    
+    /** Any thread: a drop at a circle's offset from the middle of the pond, in pixels. */
+    void addWaterImpulse(juce::Point<float> offsetFromCentre, float strength) { water.addImpulse(offsetFromCentre / pondRadius, strength); }
+    
+    /** Any thread: queues an FM grain, stamped with Time::getMillisecondCounterHiRes().
+        Ignored while the "grains" level is at 0.
+    */
+    void triggerGrain(const GrainEngine::Request& request);
+    
+    /** The voice as the audio thread renders it, for the editor's scope and spectrum. */
+    AnalyserFeed& getAnalyserFeed() noexcept { return analyserFeed; }
+    
+    /** 0 at full quality; higher while the governor is shedding load. */
+    int getQualityLevel() const noexcept { return governor.getPublishedLevel(); }
     
 private:
     
+    static constexpr int numModulators = 4;
+    
+    template <typename SampleType>
+    void processBlockWithEngine(juce::AudioBuffer<SampleType>& buffer, FMEngine<SampleType, numModulators>& engine,
+                                FMOscillator<SampleType>& oscillator);
+    
+    template <typename SampleType>
+    void applyAlgorithm(FMOscillator<SampleType>& oscillator, const FMEngine<SampleType, numModulators>& engine,
+                        int algorithm, SampleType carrierFrequency);
+    
+    template <typename SampleType>
+    void renderReverb(juce::AudioBuffer<SampleType>& buffer, int startSample, const SampleType* voice, int numSamples);
+    
+    template <typename SampleType>
+    void renderGrains(juce::AudioBuffer<SampleType>& buffer, int startSample, int numSamples);
+    
+    template <typename SampleType>
+    void applyQualityLevel(FMEngine<SampleType, numModulators>& engine);
+    
+    template <typename SampleType>
+    void applyWaterDepths(FMEngine<SampleType, numModulators>& engine);
+    
+    const MipmappedWavetable* getWavetable(juce::StringRef parameterID, const MipmappedWavetable* drawn) const noexcept;
+    const MipmappedWavetable* acquireDrawnWavetable() noexcept;
+    
+    template <typename SampleType>
+    juce::Point<float> getVoicePosition(const FMEngine<SampleType, numModulators>& engine) const noexcept;
+    
+    template <typename SampleType>
+    void applyModulatorCommand(FMEngine<SampleType, numModulators>& engine, int modulationIndexID, float frequency, float increment);
+    
+    template <typename SampleType>
+    void reclaimModulators(const FMEngine<SampleType, numModulators>& engine);
+    
     juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
     
-    float distance_center = 0;
-    float scaled_distance = 0;
-    int ID;
-    
-    bool rampComplete = false;
-    
-    bool modulationCompleted = false;
-    bool modulationCompleted2 = false;
-    bool modulationCompleted3 = false;
-    bool modulationCompleted4 = false;
-    
-    float modulationIndex = 0.0f; // Target modulation value
-    float modulationIndex2 = 0.0f; // Target modulation value
-    float modulationIndex3 = 0.0f; // Target modulation value
-    float modulationIndex4 = 0.0f; // Target modulation value
-
-    float modulationStart = 0.0f;
-    float modulationTarget = 0.0f;
-    float modulationIncrement = 0.0f;
-    float modulationIncrement1 = 0.0f;
-    float modulationIncrement2 = 0.0f;
-    float modulationIncrement3 = 0.0f;
-    float modulationIncrement4 = 0.0f;
-    float rampTime = 0.f;
-    float rampTime1 = 0.f;
-    float rampTime2 = 0.f;
-    float rampTime3 = 0.f;
-    float rampTime4 = 0.f;
-    bool increasing1 = true;
-    bool increasing2 = true;
-    bool increasing3 = true;
-    bool increasing4 = true;
-    
-    float out_carrier;
-    float phase_carrier;
-    float incr_carrier;
-    float two_pi = 6.28318;
+    void applyModulatorCommands();
+    
+    const float modulationTarget = 1000.0f;
+    
+    // One engine per precision; the host picks which processBlock it calls
+    FMEngine<float, numModulators> floatEngine;
+    FMEngine<double, numModulators> doubleEngine;
+    
+    // The operator-graph voice, used instead of the engine's carrier when an
+    // algorithm is picked; the engine still runs the ramps that drive it
+    FMOscillator<float> floatOscillator;
+    FMOscillator<double> doubleOscillator;
+    
     float freq_carrier = *treeState.getRawParameterValue("modFreq");
     
-    float out_modulator;
-    float phase_modulator;
-    float incr_modulator;
-    float freq_modulator;
+    // Generated pitches and the parameter both set the carrier; whichever
+    // moved last wins. The parameter echoing a recorded pitch doesn't count.
+    PitchMailbox pitchMailbox;
+    static constexpr juce::uint32 hostPitchIntervalMs = 250;
+    float lastParameterFrequency = 0.0f;                // audio thread
+    std::atomic<float> recordedFrequency { -1.0f };     // the value the last recording wrote
     
-    float out_modulator2;
-    float phase_modulator2;
-    float incr_modulator2;
-    float freq_modulator2;
+    SpatialPanner panner;
     
-    float out_modulator3;
-    float phase_modulator3;
-    float incr_modulator3;
-    float freq_modulator3;
+    // Probed under each modulator's circle; "water" sets how far the height there moves its depth
+    WaterSimulation water;
+    static constexpr float waterDepthPerHeight = 4.0f;
     
-    float out_modulator4;
-    float phase_modulator4;
-    float incr_modulator4;
-    float freq_modulator4;
+    QualityGovernor governor;
+    int appliedQualityLevel = 0;
+    std::array<juce::Point<float>, numModulators> modulatorPositions {}; // audio thread, in pond radii
     
-    float fmIndex;
-
-    juce::dsp::Oscillator<float> osc { [](float x) { return std::sin (x); }};
-    juce::dsp::Oscillator<float> modulatorOscillator { [](float x) { return std::sin (x); }};
-//    juce::dsp::Oscillator<float> modulatorOscillator2 { [](float x) { return std::sin (x); }};
+    juce::dsp::Gain<float> gain; // the reverb's wet level
     
-    float fmMod { 0.0f };
-    float fmDepth { 0.0f };
-    float lastFreq { 0 };
+    juce::SharedResourcePointer<SharedImpulseResponse> sharedImpulseResponse;
+    SharedImpulseResponse::Reader impulseResponseReader;
+    ConvolutionReverb reverb;
+    juce::AudioBuffer<float> reverbBuffer;
+    bool reverbRunning = false;
     
-    float fmMod2 { 0.0f };
-    float fmDepth2 { 0.0f };
-    float lastFreq2 { 0 };
+    // Grains from wave crossings, on top of the voice and outside the reverb
+    GrainEngine grains;
+    juce::AudioBuffer<float> grainBuffer;
+    juce::dsp::Gain<float> grainGain;
+    bool grainsAudible = false;
+    static constexpr float grainLevel = 0.1f;   // so a few dozen overlapping grains don't clip
     
-//    float cyclesPerSecond;
-//    float delta;
-//    float angleDelta { 0.0f };
-//    float phase { 0.0f };
+    AnalyserFeed analyserFeed;
     
+    juce::SharedResourcePointer<SharedDSPTables> sharedTables;
+    std::atomic<const Tuning*> activeTuning { &sharedTables->getDefaultTuning() }; // owned by sharedTables
     
-    juce::dsp::Gain<float> gain;
+    // The drawn table and the one before it; the audio thread marks which
+    // it is using, so the other can go when the next one is drawn
+    std::unique_ptr<MipmappedWavetable> drawnWavetableOwner, previousDrawnWavetable;
+    std::atomic<const MipmappedWavetable*> drawnWavetable { nullptr };
+    std::atomic<const MipmappedWavetable*> drawnWavetableInUse { nullptr };
     
-    float quantizeFrequency(float frequency)
+    // Circles claim modulators here; the audio thread hands them back
+    SlotAllocator<numModulators> modulatorSlots;
+    
+    // The engines are owned by the audio thread. Other threads hand over
+    // modulator changes through this queue.
+    struct ModulatorCommand
     {
-            auto closest = std::min_element(lydianScaleFrequencies.begin(), lydianScaleFrequencies.end(),
-                [frequency](float a, float b) {
-                    return std::abs(a - frequency) < std::abs(b - frequency);
-                });
-
-            return *closest;
-    }
-    
-    const std::array<float, 28> lydianScaleFrequencies = {
-        // Octave 3
-        130.81f, // C3 (Root)
-        146.83f, // D3 (Major Second)
-        164.81f, // E3 (Major Third)
-        185.00f, // F#3 (Augmented Fourth)
-        196.00f, // G3 (Perfect Fifth)
-        220.00f, // A3 (Major Sixth)
-        246.94f, // B3 (Major Seventh)
-
-        // Octave 4
-        261.63f, // C4 (Root)
-        293.66f, // D4 (Major Second)
-        329.63f, // E4 (Major Third)
-        369.99f, // F#4 (Augmented Fourth)
-        392.00f, // G4 (Perfect Fifth)
-        440.00f, // A4 (Major Sixth)
-        493.88f, // B4 (Major Seventh)
-
-        // Octave 5
-        523.25f, // C5 (Root)
-        587.33f, // D5 (Major Second)
-        659.26f, // E5 (Major Third)
-        739.99f, // F#5 (Augmented Fourth)
-        783.99f, // G5 (Perfect Fifth)
-        880.00f, // A5 (Major Sixth)
-        987.77f, // B5 (Major Seventh)
-
-        // Octave 6
-        1046.50f, // C6 (Root)
-        1174.66f, // D6 (Major Second)
-        1318.51f, // E6 (Major Third)
-        1479.98f, // F#6 (Augmented Fourth)
-        1567.98f, // G6 (Perfect Fifth)
-        1760.00f, // A6 (Major Sixth)
-        1975.53f  // B6 (Major Seventh)
+        ModulatorHandle modulator;
+        float frequency;
+        float increment;
+        juce::Point<float> position;
     };
+    
+    MultiProducerQueue<ModulatorCommand, 256> modulatorCommands;
+    
+   #if TEKHNE_PROFILING
+    DSPProfiler profiler;
+   #endif
+    
+   #if TEKHNE_LATENCY_HISTOGRAMS
+    LatencyMonitor latencyMonitor;
+    juce::SharedResourcePointer<LatencyReportWriter> latencyReportWriter;
+   #endif
 
 
     //==============================================================================
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/*
+    Trades fidelity for headroom when processBlock gets close to its deadline.
+
+    The audio thread reports how long each block took with addBlock(). Load is
+    that time over the block's duration, smoothed. Above stepDownLoad, or on
+    one block above panicLoad, the level drops by one. Once the load has been
+    below stepUpLoad for stepUpSeconds it rises by one again. The gap between
+    the two thresholds and the hold time after every change stop it
+    oscillating. The caller applies getLevel() (0 is full quality) and is
+    responsible for crossfading.
+*/
+class QualityGovernor
+{
+public:
+    static constexpr int numLevels = 4;
+
+    struct Thresholds
+    {
+        double stepDownLoad = 0.7;      // smoothed load that costs a level
+        double panicLoad = 0.9;         // a single block this slow costs a level straight away
+        double stepUpLoad = 0.35;       // smoothed load that has to hold for stepUpSeconds to win one back
+        double stepUpSeconds = 2.0;
+        double holdSeconds = 0.25;      // no further change for this long after any step
+        double smoothingSeconds = 0.1;
+    };
+
+    void prepare(double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        smoothedLoad = 0.0;
+        secondsSinceChange = 0.0;
+        secondsBelowStepUp = 0.0;
+        level = 0;
+        publishedLevel = 0;
+    }
+
+    void setThresholds(const Thresholds& newThresholds) noexcept { thresholds = newThresholds; }
+
+    /** Audio thread: one processed block and how long it took. */
+    void addBlock(double elapsedSeconds, int numSamples) noexcept
+    {
+        if (numSamples <= 0)
+            return;
+
+        const double blockSeconds = numSamples / sampleRate;
+        const double load = elapsedSeconds / blockSeconds;
+        const double smoothing = juce::jmin(1.0, blockSeconds / thresholds.smoothingSeconds);
+
+        smoothedLoad += (load - smoothedLoad) * smoothing;
+        secondsSinceChange += blockSeconds;
+        secondsBelowStepUp = smoothedLoad < thresholds.stepUpLoad ? secondsBelowStepUp + blockSeconds : 0.0;
+
+        if (secondsSinceChange < thresholds.holdSeconds)
+            return;
+
+        if ((smoothedLoad > thresholds.stepDownLoad || load > thresholds.panicLoad) && level < numLevels - 1)
+            setLevel(level + 1);
+        else if (secondsBelowStepUp >= thresholds.stepUpSeconds && level > 0)
+            setLevel(level - 1);
+    }
+
+    /** Audio thread: the level to render at, 0 being full quality. */
+    int getLevel() const noexcept { return level; }
+
+    /** Any thread: the last level chosen, for display. */
+    int getPublishedLevel() const noexcept { return publishedLevel.load(std::memory_order_relaxed); }
+
+private:
+    void setLevel(int newLevel) noexcept
+    {
+        level = newLevel;
+        publishedLevel.store(newLevel, std::memory_order_relaxed);
+        secondsSinceChange = 0.0;
+        secondsBelowStepUp = 0.0;
+    }
+
+    Thresholds thresholds;
+    double sampleRate = 44100.0;
+
+    double smoothedLoad = 0.0;
+    double secondsSinceChange = 0.0;
+    double secondsBelowStepUp = 0.0;
+    int level = 0;
+    std::atomic<int> publishedLevel { 0 };
+};
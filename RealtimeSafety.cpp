@@ -0,0 +1,242 @@
+#include "RealtimeSafety.h"
+
+#if TEKHNE_REALTIME_SAFETY_CHECKS
+
+#include <new>
+
+#if defined (__GLIBC__)
+ #include <dlfcn.h>
+ #include <pthread.h>
+
+extern "C" void* __libc_malloc(size_t);
+extern "C" void* __libc_calloc(size_t, size_t);
+extern "C" void* __libc_realloc(void*, size_t);
+extern "C" void  __libc_free(void*);
+#endif
+
+namespace RealtimeSafety
+{
+    namespace
+    {
+        // Plain thread_local ints: no constructors, so they are safe to touch
+        // from inside malloc before anything else is initialised.
+        thread_local int realtimeDepth = 0;
+        thread_local int suspendDepth = 0;
+
+        std::atomic<int> numViolations { 0 };
+        std::atomic<FailureMode> failureMode { FailureMode::report };
+        std::atomic<ViolationHandler> customHandler { nullptr };
+
+        const char* getViolationName(Violation violation) noexcept
+        {
+            switch (violation)
+            {
+                case Violation::allocation:     return "allocation";
+                case Violation::deallocation:   return "deallocation";
+                case Violation::mutexLock:      return "mutex lock";
+            }
+
+            return "violation";
+        }
+
+        struct EnvironmentDefaults
+        {
+            EnvironmentDefaults()
+            {
+                if (const auto* value = std::getenv("TEKHNE_RT_SAFETY_ABORT"))
+                    if (value[0] == '1')
+                        failureMode = FailureMode::abort;
+            }
+        };
+
+        const EnvironmentDefaults environmentDefaults;
+    }
+
+    ScopedRealtimeSection::ScopedRealtimeSection() noexcept    { ++realtimeDepth; }
+    ScopedRealtimeSection::~ScopedRealtimeSection() noexcept   { --realtimeDepth; }
+
+    ScopedAllowViolations::ScopedAllowViolations() noexcept    { ++suspendDepth; }
+    ScopedAllowViolations::~ScopedAllowViolations() noexcept   { --suspendDepth; }
+
+    bool isInRealtimeSection() noexcept
+    {
+        return realtimeDepth > 0 && suspendDepth == 0;
+    }
+
+    void reportViolation(Violation violation) noexcept
+    {
+        ++numViolations;
+
+        // Building the report allocates, so the check is off until it's done.
+        const ScopedAllowViolations reporting;
+
+        const auto callStack = juce::SystemStats::getStackBacktrace();
+
+        if (auto handler = customHandler.load())
+        {
+            handler(violation, callStack.toRawUTF8());
+        }
+        else
+        {
+            juce::Logger::writeToLog(juce::String("Real-time violation in audio callback: ") + getViolationName(violation) + "\n" + callStack);
+            jassertfalse;
+        }
+
+        if (failureMode.load() == FailureMode::abort)
+            std::abort();
+    }
+
+    int getNumViolations() noexcept                             { return numViolations.load(); }
+    void resetViolationCount() noexcept                         { numViolations = 0; }
+    void setFailureMode(FailureMode mode) noexcept              { failureMode = mode; }
+    void setViolationHandler(ViolationHandler handler) noexcept { customHandler = handler; }
+}
+
+//==============================================================================
+namespace
+{
+   #if defined (__GLIBC__)
+    // Skip the interposed malloc/free below, otherwise every new is reported twice.
+    inline void* rawMalloc(size_t size) noexcept    { return __libc_malloc(size); }
+    inline void rawFree(void* ptr) noexcept         { __libc_free(ptr); }
+   #else
+    inline void* rawMalloc(size_t size) noexcept    { return std::malloc(size); }
+    inline void rawFree(void* ptr) noexcept         { std::free(ptr); }
+   #endif
+
+    inline void checkAllocation() noexcept
+    {
+        if (RealtimeSafety::isInRealtimeSection())
+            RealtimeSafety::reportViolation(RealtimeSafety::Violation::allocation);
+    }
+
+    inline void checkDeallocation(void* ptr) noexcept
+    {
+        if (ptr != nullptr && RealtimeSafety::isInRealtimeSection())
+            RealtimeSafety::reportViolation(RealtimeSafety::Violation::deallocation);
+    }
+
+    void* checkedAlloc(size_t size)
+    {
+        checkAllocation();
+
+        if (auto* ptr = rawMalloc(size == 0 ? 1 : size))
+            return ptr;
+
+        throw std::bad_alloc();
+    }
+
+    void* checkedAlignedAlloc(size_t size, std::align_val_t alignment)
+    {
+        checkAllocation();
+
+        const auto align = juce::jmax(static_cast<size_t>(alignment), sizeof(void*));
+        void* ptr = nullptr;
+
+       #if JUCE_WINDOWS
+        ptr = _aligned_malloc(size == 0 ? 1 : size, align);
+       #else
+        if (posix_memalign(&ptr, align, size == 0 ? 1 : size) != 0)
+            ptr = nullptr;
+       #endif
+
+        if (ptr == nullptr)
+            throw std::bad_alloc();
+
+        return ptr;
+    }
+
+    void checkedFree(void* ptr) noexcept
+    {
+        checkDeallocation(ptr);
+        rawFree(ptr);
+    }
+
+    void checkedAlignedFree(void* ptr) noexcept
+    {
+        checkDeallocation(ptr);
+
+       #if JUCE_WINDOWS
+        _aligned_free(ptr);
+       #else
+        rawFree(ptr);
+       #endif
+    }
+}
+
+void* operator new(size_t size)                                                 { return checkedAlloc(size); }
+void* operator new[](size_t size)                                               { return checkedAlloc(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept                 { try { return checkedAlloc(size); } catch (...) { return nullptr; } }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept               { try { return checkedAlloc(size); } catch (...) { return nullptr; } }
+void* operator new(size_t size, std::align_val_t alignment)                     { return checkedAlignedAlloc(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment)                   { return checkedAlignedAlloc(size, alignment); }
+
+void operator delete(void* ptr) noexcept                                        { checkedFree(ptr); }
+void operator delete[](void* ptr) noexcept                                      { checkedFree(ptr); }
+void operator delete(void* ptr, size_t) noexcept                                { checkedFree(ptr); }
+void operator delete[](void* ptr, size_t) noexcept                              { checkedFree(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept                      { checkedAlignedFree(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept                    { checkedAlignedFree(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept              { checkedAlignedFree(ptr); }
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept            { checkedAlignedFree(ptr); }
+
+//==============================================================================
+#if defined (__GLIBC__)
+
+// glibc lets an executable interpose these directly; the real implementations
+// stay reachable through their __libc_ aliases.
+extern "C"
+{
+    void* malloc(size_t size)
+    {
+        checkAllocation();
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size)
+    {
+        checkAllocation();
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* ptr, size_t size)
+    {
+        checkAllocation();
+        return __libc_realloc(ptr, size);
+    }
+
+    void free(void* ptr)
+    {
+        checkDeallocation(ptr);
+        __libc_free(ptr);
+    }
+
+    int pthread_mutex_lock(pthread_mutex_t* mutex)
+    {
+        using LockFunction = int (*)(pthread_mutex_t*);
+
+        // Resolved during static initialisation, long before any audio runs.
+        static const auto realLock = reinterpret_cast<LockFunction>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+
+        if (RealtimeSafety::isInRealtimeSection())
+            RealtimeSafety::reportViolation(RealtimeSafety::Violation::mutexLock);
+
+        return realLock(mutex);
+    }
+}
+
+namespace
+{
+    // Forces the dlsym lookup above to happen at load time.
+    const int resolveMutexLock = []
+    {
+        pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+        pthread_mutex_lock(&mutex);
+        pthread_mutex_unlock(&mutex);
+        return 0;
+    }();
+}
+
+#endif
+
+#endif
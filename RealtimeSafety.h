@@ -0,0 +1,89 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/*
+    Real-time safety guard for test builds.
+
+    Build with TEKHNE_REALTIME_SAFETY_CHECKS=1. Code inside a
+    TEKHNE_REALTIME_SECTION scope, which covers all of processBlock, is then
+    not allowed to allocate or block. RealtimeSafety.cpp replaces global
+    operator new/delete. On glibc it also intercepts malloc, calloc, realloc,
+    free and pthread_mutex_lock. Any of these inside a real-time section is a
+    violation. Violations are counted and reported with the current call
+    stack.
+
+    Headless test runs set TEKHNE_RT_SAFETY_ABORT=1 in the environment, or
+    call setFailureMode(FailureMode::abort), so the first violation kills the
+    process and the run fails.
+
+    With the flag at 0 (the default) all of this compiles to nothing. Never
+    ship with it enabled: the allocator replacements affect the whole host
+    process.
+*/
+
+#ifndef TEKHNE_REALTIME_SAFETY_CHECKS
+ #define TEKHNE_REALTIME_SAFETY_CHECKS 0
+#endif
+
+#if TEKHNE_REALTIME_SAFETY_CHECKS
+
+namespace RealtimeSafety
+{
+    enum class Violation
+    {
+        allocation,
+        deallocation,
+        mutexLock
+    };
+
+    enum class FailureMode
+    {
+        report,     // DBG the call stack and hit a jassert
+        abort       // report, then std::abort() so headless tests fail
+    };
+
+    using ViolationHandler = void (*)(Violation, const char* callStack);
+
+    /** Marks the current thread as running real-time code for its lifetime. */
+    class ScopedRealtimeSection
+    {
+    public:
+        ScopedRealtimeSection() noexcept;
+        ~ScopedRealtimeSection() noexcept;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedRealtimeSection)
+    };
+
+    /** Suspends checking on this thread, e.g. around a deliberate, reviewed allocation. */
+    class ScopedAllowViolations
+    {
+    public:
+        ScopedAllowViolations() noexcept;
+        ~ScopedAllowViolations() noexcept;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedAllowViolations)
+    };
+
+    bool isInRealtimeSection() noexcept;
+
+    /** Called by the interceptors; public so other wrappers can report too. */
+    void reportViolation(Violation) noexcept;
+
+    int getNumViolations() noexcept;
+    void resetViolationCount() noexcept;
+
+    void setFailureMode(FailureMode) noexcept;
+
+    /** Replaces the default report; pass nullptr to restore it. */
+    void setViolationHandler(ViolationHandler) noexcept;
+}
+
+ #define TEKHNE_REALTIME_SECTION  RealtimeSafety::ScopedRealtimeSection JUCE_JOIN_MACRO(realtimeSection_, __LINE__)
+
+#else
+
+ #define TEKHNE_REALTIME_SECTION
+
+#endif
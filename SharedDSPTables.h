@@ -0,0 +1,154 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "Tuning.h"
+#include "Wavetable.h"
+
+//==============================================================================
+/*
+    Read-only tables shared by every Tekhne instance in the process.
+
+    Hold one through juce::SharedResourcePointer<SharedDSPTables>: the first
+    instance builds the tables, later ones just take a reference, and the
+    object goes away with the last instance. Everything reachable from the
+    audio thread is immutable once published.
+*/
+class SharedDSPTables
+{
+public:
+    static constexpr int sineTableSize = 4096; // power of two, so the index wraps with a mask
+    static constexpr double radiansToIndex = sineTableSize / juce::MathConstants<double>::twoPi;
+
+    SharedDSPTables()
+    {
+        for (int i = 0; i <= sineTableSize; ++i)
+            sineTable[static_cast<size_t>(i)] = static_cast<float>(std::sin(juce::MathConstants<double>::twoPi * i / sineTableSize));
+
+        for (int i = 0; i <= fmDepthTableSize; ++i)
+        {
+            const float x = fmDepthTableRange * static_cast<float>(i) / fmDepthTableSize;
+            fmDepthTable[static_cast<size_t>(i)] = computeFmDepth(x);
+        }
+
+        for (auto waveform : { Waveform::saw, Waveform::square, Waveform::triangle })
+            wavetables[static_cast<size_t>(waveform)] = MipmappedWavetable::create(waveform);
+    }
+
+    //==============================================================================
+    /** Linearly interpolated sin() for any non-negative phase in radians.
+        The table is float either way; a double phase only keeps its precision
+        up to the lookup.
+    */
+    template <typename SampleType>
+    SampleType sine(SampleType phase) const noexcept
+    {
+        const SampleType position = phase * static_cast<SampleType>(radiansToIndex);
+        const int index = static_cast<int>(position);
+        const SampleType fraction = position - static_cast<SampleType>(index);
+        const auto* entry = sineTable.data() + (index & (sineTableSize - 1));
+
+        return static_cast<SampleType>(entry[0]) + fraction * static_cast<SampleType>(entry[1] - entry[0]);
+    }
+
+    /** sineTableSize + 1 entries over one cycle; the last repeats the first so interpolation never wraps. */
+    const float* getSineTable() const noexcept { return sineTable.data(); }
+
+    /** The exponential distance-to-depth mapping, tabulated over 0..2000. */
+    float fmDepth(float x) const noexcept
+    {
+        if (x <= 500.0f)
+            return 0.0f;
+
+        if (x >= fmDepthTableRange)
+            return computeFmDepth(x);
+
+        const float position = x * (fmDepthTableSize / fmDepthTableRange);
+        const int index = static_cast<int>(position);
+        const float fraction = position - static_cast<float>(index);
+
+        return fmDepthTable[static_cast<size_t>(index)] + fraction * (fmDepthTable[static_cast<size_t>(index) + 1] - fmDepthTable[static_cast<size_t>(index)]);
+    }
+
+    static float computeFmDepth(float x) noexcept
+    {
+        if (x <= 500.0f)
+            return 0.0f;
+
+        const float C = 14.f; // Calculated scaling factor
+        const float B = 0.005f; // Chosen growth rate
+        return C * (std::exp(B * (x - 500.0f)) - 1);
+    }
+
+    /** The band-limited table for a built-in shape, or nullptr for the sine
+        (which uses the sine table above) and for drawn shapes, which belong to
+        each instance.
+    */
+    const MipmappedWavetable* getWavetable(Waveform waveform) const noexcept
+    {
+        return wavetables[static_cast<size_t>(waveform)].get();
+    }
+
+    //==============================================================================
+    const Tuning& getDefaultTuning() const noexcept { return defaultTuning; }
+
+    /** Returns the tuning for a Scala file, parsing it only the first time any
+        instance asks for those contents. The file is read on every call, so
+        an edited .scl gives a new tuning. Call from the message thread; the
+        returned tuning stays valid for as long as this object exists.
+    */
+    const Tuning* getScalaTuning(const juce::File& sclFile, double rootFrequency, int numPeriods, juce::Result& result)
+    {
+        if (! sclFile.existsAsFile())
+        {
+            result = juce::Result::fail("Tuning file not found: " + sclFile.getFullPathName());
+            return nullptr;
+        }
+
+        const auto contents = sclFile.loadFileAsString();
+        const juce::ScopedLock sl(tuningLock);
+
+        for (auto* cached : scalaTunings)
+        {
+            if (cached->contents == contents && cached->rootFrequency == rootFrequency && cached->numPeriods == numPeriods)
+            {
+                result = juce::Result::ok();
+                return &cached->tuning;
+            }
+        }
+
+        auto entry = std::make_unique<ScalaTuning>();
+        result = Tuning::fromScala(contents, rootFrequency, numPeriods, entry->tuning);
+
+        if (result.failed())
+            return nullptr;
+
+        entry->contents = contents;
+        entry->rootFrequency = rootFrequency;
+        entry->numPeriods = numPeriods;
+
+        return &scalaTunings.add(std::move(entry))->tuning;
+    }
+
+private:
+    static constexpr int fmDepthTableSize = 2048;
+    static constexpr float fmDepthTableRange = 2000.0f;
+
+    struct ScalaTuning
+    {
+        juce::String contents;      // the key, so an edited file isn't mistaken for the old one
+        double rootFrequency = 0.0;
+        int numPeriods = 0;
+        Tuning tuning;
+    };
+
+    std::array<float, sineTableSize + 1> sineTable;
+    std::array<float, fmDepthTableSize + 1> fmDepthTable;
+    std::array<std::unique_ptr<MipmappedWavetable>, static_cast<size_t>(Waveform::drawn) + 1> wavetables;
+
+    const Tuning defaultTuning;
+
+    juce::CriticalSection tuningLock;
+    juce::OwnedArray<ScalaTuning> scalaTunings;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SharedDSPTables)
+};
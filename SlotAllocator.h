@@ -0,0 +1,159 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/** A claim on one slot of a SlotAllocator. It goes stale as soon as the slot
+    is reclaimed, even if the same slot is handed out again.
+*/
+struct SlotHandle
+{
+    int slot = -1;
+    juce::uint32 generation = 0;
+
+    bool isValid() const noexcept { return slot >= 0; }
+};
+
+//==============================================================================
+/*
+    Capacity slots shared between a scene that claims them and a realtime
+    side that finishes with them, with no locks on either side.
+
+    A slot goes free -> live (allocate) -> releasing (release) -> free
+    (reclaim). The scene allocates and releases; the realtime side reclaims
+    once whatever the slot drives has wound down, so nothing is handed out
+    while it is still busy. Each reclaim bumps the slot's generation, and a
+    handle only matches the generation it was issued with, so stale handles
+    are turned away everywhere.
+
+    Free slots sit in a Treiber stack whose head carries a counter against
+    ABA. A slot's state and generation share one atomic word, so a release
+    can't land on a slot that was reclaimed and handed out in between.
+*/
+template <int Capacity>
+class SlotAllocator
+{
+public:
+    static constexpr int capacity = Capacity;
+
+    SlotAllocator() noexcept
+    {
+        for (int slot = 0; slot < Capacity; ++slot)
+        {
+            words[static_cast<size_t>(slot)].store(makeWord(0, State::free), std::memory_order_relaxed);
+            nextFree[static_cast<size_t>(slot)].store(slot + 1 < Capacity ? slot + 1 : -1, std::memory_order_relaxed);
+        }
+
+        freeHead.store(pack(0, 0));
+    }
+
+    /** Any thread: a live slot, or an invalid handle while every slot is taken. */
+    SlotHandle allocate() noexcept
+    {
+        auto head = freeHead.load(std::memory_order_acquire);
+        int slot;
+
+        do
+        {
+            slot = indexOf(head);
+
+            if (slot < 0)
+                return {};
+        }
+        while (! freeHead.compare_exchange_weak(head, pack(nextFree[static_cast<size_t>(slot)].load(std::memory_order_relaxed), tagOf(head) + 1),
+                                                std::memory_order_acq_rel, std::memory_order_acquire));
+
+        auto& word = words[static_cast<size_t>(slot)];
+        const auto generation = word.load(std::memory_order_relaxed) >> stateBits;
+        word.store(makeWord(generation, State::live), std::memory_order_release);
+
+        return { slot, generation };
+    }
+
+    /** Any thread: the scene is done with the slot. False if the handle was stale or already released. */
+    bool release(SlotHandle handle) noexcept
+    {
+        if (! isInRange(handle))
+            return false;
+
+        auto expected = makeWord(handle.generation, State::live);
+        return words[static_cast<size_t>(handle.slot)].compare_exchange_strong(expected, makeWord(handle.generation, State::releasing),
+                                                                                std::memory_order_acq_rel);
+    }
+
+    /** True while the handle's slot is allocated and not yet released. */
+    bool isLive(SlotHandle handle) const noexcept
+    {
+        return isInRange(handle) && words[static_cast<size_t>(handle.slot)].load(std::memory_order_acquire) == makeWord(handle.generation, State::live);
+    }
+
+    /** True until the handle's slot is reclaimed, released or not. */
+    bool isCurrent(SlotHandle handle) const noexcept
+    {
+        if (! isInRange(handle))
+            return false;
+
+        const auto word = words[static_cast<size_t>(handle.slot)].load(std::memory_order_acquire);
+        return (word >> stateBits) == handle.generation && (word & stateMask) != static_cast<juce::uint32>(State::free);
+    }
+
+    /** Realtime side: true while a slot is released but not yet reclaimed. */
+    bool isReleasing(int slot) const noexcept
+    {
+        return (words[static_cast<size_t>(slot)].load(std::memory_order_acquire) & stateMask) == static_cast<juce::uint32>(State::releasing);
+    }
+
+    /** Realtime side: frees a released slot for reuse and turns its handles stale. */
+    bool reclaim(int slot) noexcept
+    {
+        auto& word = words[static_cast<size_t>(slot)];
+        auto expected = word.load(std::memory_order_acquire);
+
+        if ((expected & stateMask) != static_cast<juce::uint32>(State::releasing)
+             || ! word.compare_exchange_strong(expected, makeWord((expected >> stateBits) + 1, State::free), std::memory_order_acq_rel))
+            return false;
+
+        auto head = freeHead.load(std::memory_order_relaxed);
+
+        do
+        {
+            nextFree[static_cast<size_t>(slot)].store(indexOf(head), std::memory_order_relaxed);
+        }
+        while (! freeHead.compare_exchange_weak(head, pack(slot, tagOf(head) + 1), std::memory_order_release, std::memory_order_relaxed));
+
+        return true;
+    }
+
+private:
+    enum class State : juce::uint32
+    {
+        free = 0,
+        live,
+        releasing
+    };
+
+    static constexpr int stateBits = 2;
+    static constexpr juce::uint32 stateMask = (1u << stateBits) - 1;
+
+    static constexpr juce::uint32 makeWord(juce::uint32 generation, State state) noexcept
+    {
+        return (generation << stateBits) | static_cast<juce::uint32>(state);
+    }
+
+    // The head packs the top slot, or -1, with a counter bumped on every change
+    static constexpr juce::uint64 pack(int slot, juce::uint32 tag) noexcept
+    {
+        return (static_cast<juce::uint64>(tag) << 32) | static_cast<juce::uint32>(slot);
+    }
+
+    static constexpr int indexOf(juce::uint64 head) noexcept           { return static_cast<int>(static_cast<juce::uint32>(head)); }
+    static constexpr juce::uint32 tagOf(juce::uint64 head) noexcept    { return static_cast<juce::uint32>(head >> 32); }
+
+    static bool isInRange(SlotHandle handle) noexcept { return juce::isPositiveAndBelow(handle.slot, Capacity); }
+
+    std::array<std::atomic<juce::uint32>, Capacity> words;     // generation << stateBits | State
+    std::array<std::atomic<int>, Capacity> nextFree;
+    std::atomic<juce::uint64> freeHead { 0 };
+
+    static_assert(std::atomic<juce::uint64>::is_always_lock_free, "the free list head must be lock-free");
+};
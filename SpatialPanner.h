@@ -0,0 +1,268 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "DSPKernels.h"
+
+//==============================================================================
+/*
+    Places the mono FM voice on the output bus from a position on the pond.
+
+    Positions are relative to the listener at the centre of the editor. One
+    unit is the 350 px the modulator ramps are scaled by. +x is right and +y
+    is down, so the top of the pond is the front. A source at distance 1 or
+    more comes from one direction; closer in, it spreads evenly over all
+    speakers.
+
+    Layouts:
+    - Speaker rings (quad, 5.1, 7.1) pan constant-power between the two
+      neighbouring speakers. LFE gets nothing.
+    - Stereo pans on x alone.
+    - A first-order ambisonic bus (AmbiX: ACN order, SN3D) gets a
+      horizontal encode.
+    - Any other layout gets the same signal on every channel.
+
+    Gains move to a new position over one block, through one gain-ramped
+    copy per channel. Unplaced sound such as the reverb is added with
+    renderDiffuse(): evenly over the speakers, or into W alone.
+*/
+class SpatialPanner
+{
+public:
+    static constexpr int maxChannels = 8;
+
+    static bool isLayoutSupported(const juce::AudioChannelSet& layout)
+    {
+        return layout == juce::AudioChannelSet::mono()
+            || layout == juce::AudioChannelSet::stereo()
+            || layout == juce::AudioChannelSet::quadraphonic()
+            || layout == juce::AudioChannelSet::create5point1()
+            || layout == juce::AudioChannelSet::create7point1()
+            || layout == juce::AudioChannelSet::ambisonic(1);
+    }
+
+    /** Call off the audio thread whenever the bus layout may have changed. */
+    void prepare(const juce::AudioChannelSet& layout)
+    {
+        numChannels = juce::jmin(layout.size(), maxChannels);
+        numRingSpeakers = 0;
+
+        if (layout.getAmbisonicOrder() == 1)
+            mode = Mode::ambisonic;
+        else if (layout == juce::AudioChannelSet::stereo())
+            mode = Mode::stereo;
+        else if (isLayoutSupported(layout) && numChannels > 2)
+            mode = Mode::ring;
+        else
+            mode = Mode::uniform;
+
+        if (mode == Mode::ring)
+        {
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                const float azimuth = getSpeakerAzimuth(layout.getTypeOfChannel(channel));
+
+                if (! std::isnan(azimuth))
+                    ringSpeakers[static_cast<size_t>(numRingSpeakers++)] = { azimuth, channel };
+            }
+
+            std::sort(ringSpeakers.begin(), ringSpeakers.begin() + numRingSpeakers,
+                      [](const RingSpeaker& a, const RingSpeaker& b) { return a.azimuth < b.azimuth; });
+        }
+
+        kernels = &DSPKernels::select();
+        computeGains({}, diffuseGains);   // a source at the centre is already spread evenly
+        computeGains({}, targetGains);
+        currentGains = targetGains;
+    }
+
+    /** Sets where the voice should be by the end of the next render(). */
+    void setPosition(juce::Point<float> position) noexcept
+    {
+        computeGains(position, targetGains);
+    }
+
+    /** Writes source into every channel of the bus. */
+    template <typename SampleType>
+    void render(juce::AudioBuffer<SampleType>& buffer, int startSample, const SampleType* source, int numSamples) noexcept
+    {
+        const int numToRender = juce::jmin(buffer.getNumChannels(), numChannels);
+
+        for (int channel = 0; channel < numToRender; ++channel)
+        {
+            const float startGain = currentGains[static_cast<size_t>(channel)];
+            const float endGain = targetGains[static_cast<size_t>(channel)];
+            auto* output = buffer.getWritePointer(channel, startSample);
+
+            if constexpr (std::is_same_v<SampleType, float>)
+                kernels->copyWithGainRamp(output, source, startGain, endGain, numSamples);
+            else
+                buffer.copyFromWithRamp(channel, startSample, source, numSamples, startGain, endGain);
+        }
+
+        for (int channel = numToRender; channel < buffer.getNumChannels(); ++channel)
+            buffer.clear(channel, startSample, numSamples);
+
+        currentGains = targetGains;
+    }
+
+    /** Adds a signal with no position to every channel of the bus. */
+    template <typename SampleType>
+    void renderDiffuse(juce::AudioBuffer<SampleType>& buffer, int startSample, const float* source, int numSamples) noexcept
+    {
+        const int numToRender = juce::jmin(buffer.getNumChannels(), numChannels);
+
+        for (int channel = 0; channel < numToRender; ++channel)
+        {
+            const float gain = diffuseGains[static_cast<size_t>(channel)];
+            auto* output = buffer.getWritePointer(channel, startSample);
+
+            if (gain == 0.0f)
+                continue;
+
+            if constexpr (std::is_same_v<SampleType, float>)
+            {
+                juce::FloatVectorOperations::addWithMultiply(output, source, gain, numSamples);
+            }
+            else
+            {
+                for (int sample = 0; sample < numSamples; ++sample)
+                    output[sample] += static_cast<SampleType>(gain * source[sample]);
+            }
+        }
+    }
+
+private:
+    enum class Mode
+    {
+        uniform,
+        stereo,
+        ring,
+        ambisonic
+    };
+
+    struct RingSpeaker
+    {
+        float azimuth;  // degrees, clockwise from the front
+        int channel;
+    };
+
+    using Gains = std::array<float, maxChannels>;
+
+    static float getSpeakerAzimuth(juce::AudioChannelSet::ChannelType type) noexcept
+    {
+        using Set = juce::AudioChannelSet;
+
+        switch (type)
+        {
+            case Set::centre:              return 0.0f;
+            case Set::right:               return 30.0f;
+            case Set::rightSurroundSide:   return 90.0f;
+            case Set::rightSurround:       return 110.0f;
+            case Set::rightSurroundRear:   return 150.0f;
+            case Set::leftSurroundRear:    return 210.0f;
+            case Set::leftSurround:        return 250.0f;
+            case Set::leftSurroundSide:    return 270.0f;
+            case Set::left:                return 330.0f;
+            default:                       return std::numeric_limits<float>::quiet_NaN(); // LFE and anything unplaced
+        }
+    }
+
+    void computeGains(juce::Point<float> position, Gains& gains) const noexcept
+    {
+        gains.fill(0.0f);
+
+        const float distance = juce::jmin(1.0f, position.getDistanceFromOrigin());
+        const float azimuth = std::atan2(position.x, -position.y); // radians, clockwise from the front
+
+        switch (mode)
+        {
+            case Mode::uniform:
+            {
+                for (int channel = 0; channel < numChannels; ++channel)
+                    gains[static_cast<size_t>(channel)] = 1.0f;
+
+                break;
+            }
+
+            case Mode::stereo:
+            {
+                const float pan = juce::jlimit(-1.0f, 1.0f, position.x);
+                const float angle = (pan + 1.0f) * juce::MathConstants<float>::pi * 0.25f;
+                gains[0] = std::cos(angle);
+                gains[1] = std::sin(angle);
+                break;
+            }
+
+            case Mode::ambisonic:
+            {
+                // ACN order W, Y, Z, X; SN3D, so W stays at unity. Y points left.
+                gains[0] = 1.0f;
+                gains[1] = -std::sin(azimuth) * distance;
+                gains[3] = std::cos(azimuth) * distance;
+                break;
+            }
+
+            case Mode::ring:
+            {
+                computeRingGains(juce::radiansToDegrees(azimuth), distance, gains);
+                break;
+            }
+        }
+    }
+
+    void computeRingGains(float azimuth, float distance, Gains& gains) const noexcept
+    {
+        if (numRingSpeakers == 0)
+            return;
+
+        if (azimuth < 0.0f)
+            azimuth += 360.0f;
+
+        // The pair of neighbouring speakers either side of the source, wrapping round the back
+        int next = 0;
+
+        while (next < numRingSpeakers && ringSpeakers[static_cast<size_t>(next)].azimuth <= azimuth)
+            ++next;
+
+        const auto& a = ringSpeakers[static_cast<size_t>((next + numRingSpeakers - 1) % numRingSpeakers)];
+        const auto& b = ringSpeakers[static_cast<size_t>(next % numRingSpeakers)];
+
+        float span = b.azimuth - a.azimuth;
+        float offset = azimuth - a.azimuth;
+
+        if (span <= 0.0f)   span += 360.0f;
+        if (offset < 0.0f)  offset += 360.0f;
+
+        const float angle = juce::jlimit(0.0f, 1.0f, offset / span) * juce::MathConstants<float>::halfPi;
+        const float spread = (1.0f - distance) / std::sqrt(static_cast<float>(numRingSpeakers));
+
+        for (int i = 0; i < numRingSpeakers; ++i)
+            gains[static_cast<size_t>(ringSpeakers[static_cast<size_t>(i)].channel)] = spread;
+
+        gains[static_cast<size_t>(a.channel)] += distance * std::cos(angle);
+        gains[static_cast<size_t>(b.channel)] += distance * std::sin(angle);
+
+        // Keep the total power constant between the spread and the pair
+        float power = 0.0f;
+
+        for (auto gain : gains)
+            power += gain * gain;
+
+        if (power > 0.0f)
+        {
+            const float normalise = 1.0f / std::sqrt(power);
+
+            for (auto& gain : gains)
+                gain *= normalise;
+        }
+    }
+
+    Mode mode = Mode::uniform;
+    int numChannels = 0;
+
+    std::array<RingSpeaker, maxChannels> ringSpeakers {};
+    int numRingSpeakers = 0;
+
+    Gains currentGains {}, targetGains {}, diffuseGains {};
+    const DSPKernels* kernels = &DSPKernels::get(KernelLevel::scalar);
+};
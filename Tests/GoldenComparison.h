@@ -0,0 +1,141 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/*
+    Tolerance-based comparison of a rendered signal against a golden reference.
+
+    Table lookups, float phases and SIMD reorder the arithmetic, so optimised
+    output never matches the reference bit for bit. What matters is that the
+    error stays far below the signal (SNR) and that no part of the spectrum
+    moves (averaged magnitude spectra, compared in dB bin by bin). Paths with
+    no such reordering, like the modulation ramps, use exactlyEqual().
+*/
+
+struct GoldenTolerance
+{
+    double minSnrDb = 60.0;                 // error energy at least this far below the reference
+    double maxSpectralDeviationDb = 1.0;    // per-bin level difference of the averaged spectra
+    double spectralFloorDb = -80.0;         // bins this far below the reference peak are ignored
+};
+
+class GoldenComparator
+{
+public:
+    explicit GoldenComparator(int fftOrder = 11)
+        : fft(fftOrder),
+          window(static_cast<size_t>(1 << fftOrder), juce::dsp::WindowingFunction<float>::hann, false)
+    {
+        const auto fftSize = static_cast<size_t>(fft.getSize());
+
+        referenceFrame.resize(fftSize);
+        candidateFrame.resize(fftSize);
+        fftData.resize(2 * fftSize);
+        referenceSpectrum.resize(fftSize / 2 + 1);
+        candidateSpectrum.resize(fftSize / 2 + 1);
+
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        referenceEnergy = 0.0;
+        errorEnergy = 0.0;
+        numFrames = 0;
+        framePosition = 0;
+        std::fill(referenceSpectrum.begin(), referenceSpectrum.end(), 0.0);
+        std::fill(candidateSpectrum.begin(), candidateSpectrum.end(), 0.0);
+    }
+
+    /** Accumulates a stretch of both signals. Doesn't allocate. */
+    void addSamples(const float* reference, const float* candidate, int numSamples) noexcept
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const double error = static_cast<double>(candidate[i]) - static_cast<double>(reference[i]);
+            referenceEnergy += static_cast<double>(reference[i]) * reference[i];
+            errorEnergy += error * error;
+
+            referenceFrame[framePosition] = reference[i];
+            candidateFrame[framePosition] = candidate[i];
+
+            if (++framePosition == referenceFrame.size())
+            {
+                accumulateSpectrum(referenceFrame, referenceSpectrum);
+                accumulateSpectrum(candidateFrame, candidateSpectrum);
+                framePosition = 0;
+                ++numFrames;
+            }
+        }
+    }
+
+    double getSnrDb() const noexcept
+    {
+        if (errorEnergy <= 0.0)
+            return std::numeric_limits<double>::infinity();
+
+        return 10.0 * std::log10(referenceEnergy / errorEnergy);
+    }
+
+    /** Largest per-bin difference between the averaged spectra, or 0 if no full frame was seen. */
+    double getMaxSpectralDeviationDb(double floorDb = GoldenTolerance().spectralFloorDb) const noexcept
+    {
+        if (numFrames == 0)
+            return 0.0;
+
+        const double peak = *std::max_element(referenceSpectrum.begin(), referenceSpectrum.end());
+        const double floor = peak * std::pow(10.0, floorDb / 10.0);
+        double deviation = 0.0;
+
+        for (size_t bin = 0; bin < referenceSpectrum.size(); ++bin)
+        {
+            if (referenceSpectrum[bin] <= floor && candidateSpectrum[bin] <= floor)
+                continue;
+
+            const double ref = juce::jmax(referenceSpectrum[bin], floor);
+            const double cand = juce::jmax(candidateSpectrum[bin], floor);
+            deviation = juce::jmax(deviation, std::abs(10.0 * std::log10(cand / ref)));
+        }
+
+        return deviation;
+    }
+
+    bool passes(const GoldenTolerance& tolerance) const noexcept
+    {
+        return getSnrDb() >= tolerance.minSnrDb
+            && getMaxSpectralDeviationDb(tolerance.spectralFloorDb) <= tolerance.maxSpectralDeviationDb;
+    }
+
+    /** Bitwise comparison for paths that must not change at all. */
+    static bool exactlyEqual(const float* a, const float* b, int numSamples) noexcept
+    {
+        return std::memcmp(a, b, sizeof(float) * static_cast<size_t>(numSamples)) == 0;
+    }
+
+private:
+    void accumulateSpectrum(const std::vector<float>& frame, std::vector<double>& spectrum) noexcept
+    {
+        std::copy(frame.begin(), frame.end(), fftData.begin());
+        std::fill(fftData.begin() + static_cast<std::ptrdiff_t>(frame.size()), fftData.end(), 0.0f);
+
+        window.multiplyWithWindowingTable(fftData.data(), frame.size());
+        fft.performFrequencyOnlyForwardTransform(fftData.data(), true);
+
+        for (size_t bin = 0; bin < spectrum.size(); ++bin)
+            spectrum[bin] += static_cast<double>(fftData[bin]) * fftData[bin];
+    }
+
+    juce::dsp::FFT fft;
+    juce::dsp::WindowingFunction<float> window;
+
+    std::vector<float> referenceFrame, candidateFrame, fftData;
+    std::vector<double> referenceSpectrum, candidateSpectrum;
+    size_t framePosition = 0;
+    int numFrames = 0;
+
+    double referenceEnergy = 0.0;
+    double errorEnergy = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE(GoldenComparator)
+};
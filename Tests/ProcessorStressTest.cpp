@@ -0,0 +1,311 @@
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include "PluginEditor.h"
+
+#include <thread>
+
+//==============================================================================
+/*
+    Headless stress run for the processor's cross-thread entry points.
+
+    One thread plays the audio callback, calling processBlock back to back,
+    while others do what the editor and the host do at the same time:
+    circles claiming, moving and releasing modulators, pitches and grains
+    from wave crossings, drops in the water, and parameter automation.
+
+    The main thread runs the message loop with a real editor open, so its
+    timer, crossings and paint() run as they would in a host, and feeds it
+    synthesised clicks, slider moves and strokes on the waveform pad. The
+    run is made twice, once with float buffers and once with double.
+
+    Built with -fsanitize=thread, any data race fails the run. Built with
+    TEKHNE_REALTIME_SAFETY_CHECKS=1 instead, the first allocation, free or
+    lock inside processBlock aborts it. The output is also checked for NaNs
+    and infinities.
+
+    Usage: ProcessorStressTest [seconds], shared between the two runs
+*/
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 256;
+
+    // Points in the pond, in editor pixels from its middle
+    juce::Point<float> randomOffset(juce::Random& random)
+    {
+        const auto reach = TekhneAudioProcessor::pondRadius;
+        return { (random.nextFloat() * 2.0f - 1.0f) * reach, (random.nextFloat() * 2.0f - 1.0f) * reach };
+    }
+
+    //==============================================================================
+    // Circles come and go: each claims a modulator, moves it a few times, and
+    // lets it go again, sometimes before the audio thread has seen it at all
+    void runCircles(TekhneAudioProcessor& processor, const std::atomic<bool>& stop, int seed)
+    {
+        juce::Random random(seed);
+        std::vector<TekhneAudioProcessor::ModulatorHandle> live;
+
+        while (! stop.load())
+        {
+            if (live.size() < 4 && random.nextInt(3) != 0)
+            {
+                const auto handle = processor.allocateModulator();
+
+                if (handle.isValid())
+                    live.push_back(handle);
+            }
+
+            for (const auto& handle : live)
+                processor.setModulatorParameters(randomOffset(random), handle, 2 + random.nextInt(8));
+
+            if (! live.empty() && random.nextInt(4) == 0)
+            {
+                const auto index = static_cast<size_t>(random.nextInt(static_cast<int>(live.size())));
+                processor.releaseModulator(live[index]);
+
+                // A stale handle must be ignored, not routed to the slot's next owner
+                processor.setModulatorParameters(randomOffset(random), live[index], 5);
+                live.erase(live.begin() + static_cast<std::ptrdiff_t>(index));
+            }
+
+            std::this_thread::yield();
+        }
+
+        for (const auto& handle : live)
+            processor.releaseModulator(handle);
+    }
+
+    // What a wave crossing sends: a pitch for the carrier, a grain, and a drop
+    void runPond(TekhneAudioProcessor& processor, const std::atomic<bool>& stop, int seed)
+    {
+        juce::Random random(seed);
+
+        while (! stop.load())
+        {
+            processor.postGeneratedPitch(100.0f + random.nextFloat() * 900.0f);
+
+            processor.triggerGrain({ juce::Time::getMillisecondCounterHiRes() + random.nextFloat() * 60.0,
+                                     200.0f + random.nextFloat() * 800.0f, 1.0f + random.nextFloat() * 3.0f,
+                                     random.nextFloat() * 5.0f, 20.0f + random.nextFloat() * 200.0f, random.nextFloat() });
+
+            processor.addWaterImpulse(randomOffset(random), random.nextFloat());
+
+            std::this_thread::yield();
+        }
+    }
+
+    //==============================================================================
+    // Mouse events as the window would deliver them, with the left button down
+    juce::MouseEvent makeMouseEvent(juce::Component& component, juce::Point<float> position,
+                                    juce::Point<float> downPosition, bool dragged)
+    {
+        const auto now = juce::Time::getCurrentTime();
+
+        return { juce::Desktop::getInstance().getMainMouseSource(), position,
+                 juce::ModifierKeys(juce::ModifierKeys::leftButtonModifier),
+                 juce::MouseInputSource::defaultPressure, juce::MouseInputSource::defaultOrientation,
+                 juce::MouseInputSource::defaultRotation, juce::MouseInputSource::defaultTiltX,
+                 juce::MouseInputSource::defaultTiltY, &component, &component, now, downPosition, now, 1, dragged };
+    }
+
+    // Plays the user on the message thread: one gesture per step, then a repaint
+    class EditorDriver
+    {
+    public:
+        explicit EditorDriver(juce::AudioProcessorEditor& editorToDrive)
+            : editor(editorToDrive),
+              canvas(juce::Image::ARGB, editorToDrive.getWidth(), editorToDrive.getHeight(), true)
+        {
+            for (auto* child : editor.getChildren())
+            {
+                if (auto* slider = dynamic_cast<juce::Slider*>(child))
+                    sliders.push_back(slider);
+
+                if (auto* pad = dynamic_cast<WaveformPad*>(child))
+                    waveformPad = pad;
+            }
+        }
+
+        void step()
+        {
+            switch (random.nextInt(4))
+            {
+                case 0:  clickBurst();   break;
+                case 1:  moveSlider();   break;
+                case 2:  drawStroke();   break;
+                default:                 break;
+            }
+
+            juce::Graphics g(canvas);
+            editor.paintEntireComponent(g, false);
+        }
+
+    private:
+        juce::Point<float> randomPosition(const juce::Component& component)
+        {
+            return { random.nextFloat() * static_cast<float>(component.getWidth()),
+                     random.nextFloat() * static_cast<float>(component.getHeight()) };
+        }
+
+        // A few clicks in quick succession, each one a new circle
+        void clickBurst()
+        {
+            for (int i = 1 + random.nextInt(6); --i >= 0;)
+            {
+                const auto position = randomPosition(editor);
+                editor.mouseDown(makeMouseEvent(editor, position, position, false));
+            }
+        }
+
+        void moveSlider()
+        {
+            if (sliders.empty())
+                return;
+
+            auto* slider = sliders[static_cast<size_t>(random.nextInt(static_cast<int>(sliders.size())))];
+            const auto range = slider->getRange();
+            slider->setValue(range.getStart() + random.nextFloat() * range.getLength(), juce::sendNotificationSync);
+        }
+
+        // Down, a few drags across the pad, and up, which hands the cycle to the processor
+        void drawStroke()
+        {
+            if (waveformPad == nullptr)
+                return;
+
+            const auto start = randomPosition(*waveformPad);
+            waveformPad->mouseDown(makeMouseEvent(*waveformPad, start, start, false));
+
+            for (int i = 0; i < 8; ++i)
+                waveformPad->mouseDrag(makeMouseEvent(*waveformPad, randomPosition(*waveformPad), start, true));
+
+            waveformPad->mouseUp(makeMouseEvent(*waveformPad, randomPosition(*waveformPad), start, true));
+        }
+
+        juce::AudioProcessorEditor& editor;
+        juce::Image canvas;
+        std::vector<juce::Slider*> sliders;
+        WaveformPad* waveformPad = nullptr;
+        juce::Random random { 5 };
+    };
+
+    //==============================================================================
+    struct AudioRun
+    {
+        std::atomic<bool> stop { false };
+        std::atomic<bool> outputFinite { true };
+        std::atomic<int> numBlocks { 0 };
+    };
+
+    // The audio callback at one precision
+    template <typename SampleType>
+    void runAudio(TekhneAudioProcessor& processor, AudioRun& run)
+    {
+        juce::AudioBuffer<SampleType> buffer(2, blockSize);
+        juce::MidiBuffer midi;
+
+        while (! run.stop.load())
+        {
+            buffer.clear();
+            processor.processBlock(buffer, midi);
+
+            for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+                for (int i = 0; i < blockSize; ++i)
+                    if (! std::isfinite(buffer.getSample(channel, i)))
+                        run.outputFinite.store(false);
+
+            ++run.numBlocks;
+        }
+    }
+
+    // Host automation, from a thread of its own as some hosts do
+    void runHost(TekhneAudioProcessor& processor, const std::atomic<bool>& stop, int seed)
+    {
+        static constexpr std::array<const char*, 15> parameterIDs { "frequency", "modFreq", "fmDepth", "modFreq2", "fmDepth2",
+                                                                    "quantise", "governor", "carrierWave", "modulatorWave",
+                                                                    "algorithm", "feedback", "reverb", "water", "grains",
+                                                                    "recordPitch" };
+        juce::Random random(seed);
+
+        while (! stop.load())
+        {
+            auto* parameter = processor.treeState.getParameter(parameterIDs[static_cast<size_t>(random.nextInt(static_cast<int>(parameterIDs.size())))]);
+            parameter->setValueNotifyingHost(random.nextFloat());
+
+            std::this_thread::yield();
+        }
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+   #if TEKHNE_REALTIME_SAFETY_CHECKS
+    RealtimeSafety::setFailureMode(RealtimeSafety::FailureMode::abort);
+   #endif
+
+    const double seconds = argc > 1 ? std::atof(argv[1]) : 5.0;
+
+    TekhneAudioProcessor processor;
+    std::unique_ptr<juce::AudioProcessorEditor> editor(processor.createEditorIfNeeded());
+    EditorDriver driver(*editor);
+
+    bool failed = false;
+
+    // The editor stays open across both runs, as it would when a host re-prepares
+    for (const auto precision : { juce::AudioProcessor::singlePrecision, juce::AudioProcessor::doublePrecision })
+    {
+        const bool isDouble = precision == juce::AudioProcessor::doublePrecision;
+
+        processor.setProcessingPrecision(precision);
+        processor.prepareToPlay(sampleRate, blockSize);
+
+        AudioRun run;
+
+        std::thread audio(isDouble ? &runAudio<double> : &runAudio<float>, std::ref(processor), std::ref(run));
+        std::thread circles1(runCircles, std::ref(processor), std::cref(run.stop), 1);
+        std::thread circles2(runCircles, std::ref(processor), std::cref(run.stop), 2);
+        std::thread pond(runPond, std::ref(processor), std::cref(run.stop), 3);
+        std::thread host(runHost, std::ref(processor), std::cref(run.stop), 4);
+
+        const auto endMs = juce::Time::getMillisecondCounterHiRes() + seconds * 500.0;
+
+        while (juce::Time::getMillisecondCounterHiRes() < endMs)
+        {
+            driver.step();
+            juce::MessageManager::getInstance()->runDispatchLoopUntil(10);
+        }
+
+        run.stop.store(true);
+
+        for (auto* thread : { &audio, &circles1, &circles2, &pond, &host })
+            thread->join();
+
+        processor.releaseResources();
+
+        std::printf("%s: %d blocks\n", isDouble ? "double" : "float", run.numBlocks.load());
+
+        if (! run.outputFinite.load())
+        {
+            std::printf("FAILED: non-finite %s output\n", isDouble ? "double" : "float");
+            failed = true;
+        }
+
+        failed = failed || run.numBlocks.load() == 0;
+    }
+
+    editor.reset();
+
+   #if TEKHNE_REALTIME_SAFETY_CHECKS
+    if (RealtimeSafety::getNumViolations() > 0)
+    {
+        std::printf("FAILED: %d real-time violations\n", RealtimeSafety::getNumViolations());
+        return 1;
+    }
+   #endif
+
+    return failed ? 1 : 0;
+}
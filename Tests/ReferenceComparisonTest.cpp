@@ -0,0 +1,198 @@
+#include <JuceHeader.h>
+#include "FMEngine.h"
+#include "SharedDSPTables.h"
+#include "ReferenceFMEngine.h"
+#include "GoldenComparison.h"
+
+//==============================================================================
+/*
+    Offline check that the optimised float FMEngine still sounds like the
+    frozen ReferenceFMEngine.
+
+    Each scene is a seeded run of modulator commands, issued at block
+    boundaries the way the processor applies them, rendered through both
+    engines. Every block, the modulation ramps must match the reference
+    exactly. Every second, the output must be within GoldenTolerance (a
+    lower SNR floor for quantised scenes, see below), and
+    then the reference's phases are lined up with the engine's again, so
+    drift can't build up across windows.
+
+    The reference is frozen with the original modulator routing, quirks and
+    all. The processor has since changed on purpose to give each circle its
+    own modulator, so the scenes drive the engine with the original routing
+    instead: what is under test is the engine's arithmetic, against a
+    reference that never moves.
+
+    Usage: ReferenceComparisonTest
+*/
+
+namespace
+{
+    constexpr int blockSize = 512;
+    constexpr float modulationTarget = 1000.0f;
+
+    // Near a scale step the engine's float sum of the modulators and the
+    // reference's double sum can land on either side, so the odd stretch
+    // snaps to the neighbouring note. The spectrum is held to the usual
+    // limit; the SNR can't be.
+    constexpr GoldenTolerance quantisedTolerance { 40.0, 1.0, -80.0 };
+
+    struct Scene
+    {
+        int seed;
+        double sampleRate;
+        float carrierFrequency;
+        bool quantise;
+        double seconds;
+    };
+
+    struct Command
+    {
+        int modulationIndexID;     // 1 to numModulators
+        float frequency;
+        float increment;
+    };
+
+    // What a circle sends: wave life sets the frequency, and the distance
+    // from the middle of the pond sets how long the ramp takes
+    Command makeCommand(juce::Random& random, double sampleRate)
+    {
+        const int waveLife = 2 + random.nextInt(8);
+        const float rampSeconds = 0.05f + random.nextFloat() * 9.95f;
+
+        return { 1 + random.nextInt(ReferenceFMEngine::numModulators),
+                 juce::jmap(static_cast<float>(waveLife), 2.0f, 9.0f, 2000.0f, 5.0f),
+                 static_cast<float>(modulationTarget / (sampleRate * rampSeconds)) };
+    }
+
+    // The ramp increments as the processor routed them before each circle had
+    // a modulator of its own: modulator 1 follows whichever increment came
+    // last, modulator 4's updates land on modulator 3, and modulator 4 never
+    // ramps up but falls back at modulator 2's rate
+    void applyOriginalRouting(FMEngine<float, ReferenceFMEngine::numModulators>& engine, const Command& command)
+    {
+        const float step = command.increment;
+
+        engine.setRampIncrements(0, step, step);
+
+        if (command.modulationIndexID == 2)
+        {
+            engine.setRampIncrements(1, step, step);
+            engine.setRampIncrements(3, 0.0f, step);
+        }
+        else if (command.modulationIndexID >= 3)
+        {
+            engine.setRampIncrements(2, step, step);
+        }
+
+        engine.startModulator(command.modulationIndexID - 1, command.frequency);
+    }
+
+    //==============================================================================
+    // Returns the number of failed windows
+    int runScene(const Scene& scene, const SharedDSPTables& tables)
+    {
+        FMEngine<float, ReferenceFMEngine::numModulators> engine;
+        ReferenceFMEngine reference;
+
+        engine.prepare(scene.sampleRate, blockSize);
+        reference.prepare(scene.sampleRate);
+
+        const Tuning* quantiseTo = scene.quantise ? &tables.getDefaultTuning() : nullptr;
+        const GoldenTolerance tolerance = scene.quantise ? quantisedTolerance : GoldenTolerance {};
+
+        juce::AudioBuffer<float> referenceBuffer(1 + ReferenceFMEngine::numModulators, blockSize);
+        GoldenComparator comparator;
+        juce::Random random(scene.seed);
+
+        const int windowSamples = static_cast<int>(scene.sampleRate);
+        const int totalSamples = static_cast<int>(scene.seconds * scene.sampleRate);
+        int samplesInWindow = 0;
+        bool rampsMatched = true;
+        int failures = 0;
+
+        for (int start = 0; start < totalSamples; start += blockSize)
+        {
+            const int numSamples = juce::jmin(blockSize, totalSamples - start);
+
+            // A burst of commands now and then, as circles are dropped and waves cross
+            if (start == 0 || random.nextInt(40) == 0)
+            {
+                const int numCommands = 1 + random.nextInt(3);
+
+                for (int i = 0; i < numCommands; ++i)
+                {
+                    const auto command = makeCommand(random, scene.sampleRate);
+
+                    applyOriginalRouting(engine, command);
+                    reference.setModulator(command.modulationIndexID, command.frequency, command.increment);
+                }
+            }
+
+            if (engine.isIdle())
+            {
+                engine.renderIdle(numSamples, scene.carrierFrequency, tables, quantiseTo);
+            }
+            else
+            {
+                engine.renderRamps(numSamples);
+                engine.renderModulators(numSamples, scene.carrierFrequency, tables);
+                engine.renderCarrier(numSamples, tables, quantiseTo);
+            }
+
+            reference.process(referenceBuffer.getWritePointer(0), numSamples, scene.carrierFrequency, quantiseTo,
+                              { referenceBuffer.getWritePointer(1), referenceBuffer.getWritePointer(2),
+                                referenceBuffer.getWritePointer(3), referenceBuffer.getWritePointer(4) });
+
+            // The ramps do the same float arithmetic in the same order, so they must match exactly
+            for (int m = 0; m < ReferenceFMEngine::numModulators; ++m)
+                rampsMatched = rampsMatched && GoldenComparator::exactlyEqual(referenceBuffer.getReadPointer(1 + m),
+                                                                              engine.getRamp(m), numSamples);
+
+            comparator.addSamples(referenceBuffer.getReadPointer(0), engine.getOutput(), numSamples);
+            samplesInWindow += numSamples;
+
+            if (samplesInWindow < windowSamples && start + numSamples < totalSamples)
+                continue;
+
+            if (! rampsMatched || ! comparator.passes(tolerance))
+            {
+                std::printf("  seed %d at %.1f s: ramps %s, SNR %.1f dB, spectral deviation %.2f dB\n",
+                            scene.seed, static_cast<double>(start + numSamples) / scene.sampleRate,
+                            rampsMatched ? "match" : "DIFFER", comparator.getSnrDb(), comparator.getMaxSpectralDeviationDb(tolerance.spectralFloorDb));
+                ++failures;
+            }
+
+            reference.setPhases(engine.getCarrierPhase(), engine.getModulatorPhases());
+            comparator.reset();
+            samplesInWindow = 0;
+            rampsMatched = true;
+        }
+
+        return failures;
+    }
+}
+
+//==============================================================================
+int main()
+{
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    const SharedDSPTables tables;
+
+    static constexpr std::array<Scene, 8> scenes { { { 1, 44100.0, 440.0f, false, 8.0 },
+                                                      { 2, 48000.0, 220.0f, false, 8.0 },
+                                                      { 3, 48000.0, 880.0f, true, 8.0 },
+                                                      { 4, 96000.0, 330.0f, false, 8.0 },
+                                                      { 5, 44100.0, 110.0f, true, 8.0 },
+                                                      { 6, 48000.0, 660.0f, false, 8.0 },
+                                                      { 7, 88200.0, 550.0f, true, 8.0 },
+                                                      { 8, 48000.0, 1000.0f, false, 8.0 } } };
+
+    int failures = 0;
+
+    for (const auto& scene : scenes)
+        failures += runScene(scene, tables);
+
+    std::printf("%d failed windows\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "Tuning.h"
+
+//==============================================================================
+/*
+    The FM algorithm exactly as processBlock computed it before any of the
+    table, block-staging or SIMD work: std::sin per sample, double-precision
+    carrier increment, one sample at a time through every stage.
+
+    Keep it frozen. It exists so optimised engines have something to be
+    compared against; fixes belong in the real engine, and only a deliberate
+    change of sound should ever touch this file.
+*/
+class ReferenceFMEngine
+{
+public:
+    static constexpr int numModulators = 4;
+
+    void prepare(double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+    }
+
+    /** The modulator switch from the original setModulatorParameters(), quirks included. */
+    void setModulator(int modulationIndexID, float frequency, float increment)
+    {
+        modulationIncrement = increment;
+
+        switch (modulationIndexID)
+        {
+            case 1: freq_modulator[0] = frequency; modulationCompleted[0] = false; break;
+            case 2: freq_modulator[1] = frequency; modulationIncrementN[1] = increment; modulationCompleted[1] = false; break;
+            case 3: freq_modulator[2] = frequency; modulationIncrementN[2] = increment; modulationCompleted[2] = false; break;
+            case 4: freq_modulator[3] = frequency; modulationIncrementN[2] = increment; modulationCompleted[3] = false; break;
+            default: break;
+        }
+    }
+
+    /** Puts the oscillators at the given phases, so two engines can be lined up before a comparison window. */
+    void setPhases(float carrierPhase, const std::array<float, numModulators>& modulatorPhases)
+    {
+        phase_carrier = carrierPhase;
+        phase_modulator = modulatorPhases;
+    }
+
+    /** Renders numSamples of mono output. rampOutputs, if given, receives each modulator's index per sample. */
+    void process(float* output, int numSamples, float freq_carrier, const Tuning* quantiseTo = nullptr,
+                 std::array<float*, numModulators> rampOutputs = {})
+    {
+        std::array<float, numModulators> incr_modulator;
+
+        for (size_t m = 0; m < numModulators; ++m)
+        {
+            auto cyclesPerSample_mod = freq_modulator[m] / sampleRate;
+            incr_modulator[m] = static_cast<float>(cyclesPerSample_mod * juce::MathConstants<double>::pi);
+        }
+
+        for (int sample = 0; sample < numSamples; ++sample)
+        {
+            for (size_t m = 0; m < numModulators; ++m)
+            {
+                if (modulationCompleted[m])
+                    continue;
+
+                // Modulator 1 ramps with whichever increment was set last, and
+                // modulator 4 ramps up with its own (never set) increment but
+                // down with modulator 2's.
+                const float up = m == 0 ? modulationIncrement : modulationIncrementN[m];
+                const float down = m == 0 ? modulationIncrement : (m == 3 ? modulationIncrementN[1] : modulationIncrementN[m]);
+
+                if (increasing[m])
+                {
+                    modulationIndex[m] += up;
+
+                    if (modulationIndex[m] >= modulationTarget)
+                    {
+                        modulationIndex[m] = modulationTarget;
+                        increasing[m] = false;
+                    }
+                }
+                else
+                {
+                    modulationIndex[m] -= down;
+
+                    if (modulationIndex[m] <= modulationStart)
+                    {
+                        modulationIndex[m] = modulationStart;
+                        increasing[m] = true;
+                        modulationCompleted[m] = true;
+                    }
+                }
+            }
+
+            double modulatedFreq = freq_carrier;
+
+            for (size_t m = 0; m < numModulators; ++m)
+            {
+                double modulatorSignal = std::sin(phase_modulator[m]);
+                phase_modulator[m] += incr_modulator[m];
+
+                if (phase_modulator[m] >= two_pi)
+                    phase_modulator[m] -= two_pi;
+
+                modulatedFreq += modulationIndex[m] * modulatorSignal;
+
+                if (rampOutputs[m] != nullptr)
+                    rampOutputs[m][sample] = modulationIndex[m];
+            }
+
+            if (quantiseTo != nullptr)
+                modulatedFreq = quantiseTo->quantise(static_cast<float>(modulatedFreq));
+
+            auto cyclesPerSample_modulated = modulatedFreq / sampleRate;
+            double incr_carrier_modulated = cyclesPerSample_modulated * juce::MathConstants<double>::pi * 2.0;
+
+            phase_carrier += incr_carrier_modulated;
+
+            if (phase_carrier >= two_pi)
+                phase_carrier -= two_pi;
+
+            output[sample] = static_cast<float>(std::sin(phase_carrier)) * 0.5f;
+        }
+    }
+
+private:
+    double sampleRate = 44100.0;
+
+    const float two_pi = 6.28318;
+    const float modulationStart = 0.0f;
+    const float modulationTarget = 1000.0f;
+
+    float modulationIncrement = 0.0f;
+    std::array<float, numModulators> modulationIncrementN {};
+    std::array<float, numModulators> modulationIndex {};
+    std::array<bool, numModulators> increasing { true, true, true, true };
+    std::array<bool, numModulators> modulationCompleted { false, false, false, false };
+
+    std::array<float, numModulators> freq_modulator {};
+    std::array<float, numModulators> phase_modulator {};
+    float phase_carrier = 0.0f;
+};
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/*
+    A layer of filled and stroked ellipses, rasterised in tiles across a
+    thread pool and composited by draw().
+
+    The caller lists the frame's shapes, in drawing order, then calls
+    render(). Each shape is binned into the tiles it reaches; a stroked
+    circle only reaches the tiles its band crosses, not the ones wholly
+    inside it. A tile is redrawn only when the hash of the shapes reaching
+    it changes, so tiles that nothing moved through keep last frame's
+    pixels.
+
+    Tiles are tileSize physical pixels, so a HiDPI display gets more tiles
+    rather than a blurrier layer. They are software images, whatever the
+    platform's native type is, so the pool threads rasterise them on the
+    CPU. render() hands the dirty tiles out one at a time to the pool and
+    to the calling thread alike, and returns once they are all done.
+*/
+class TiledLayer
+{
+public:
+    static constexpr int tileSize = 128;
+
+    explicit TiledLayer(int numThreads = juce::jmax(1, juce::SystemStats::getNumCpus() - 1))
+        : pool(numThreads)
+    {
+        for (int i = 0; i < numThreads; ++i)
+            helpers.push_back(std::make_unique<HelperJob>(*this));
+    }
+
+    /** Starts a new frame's list of shapes. */
+    void clear() noexcept { shapes.clear(); }
+
+    /** An ellipse filling bounds, or outlined lineThickness wide if that is above 0. */
+    void addEllipse(juce::Rectangle<float> bounds, juce::Colour colour, float lineThickness = 0.0f)
+    {
+        shapes.push_back({ bounds, colour, lineThickness });
+    }
+
+    /** Message thread: brings the tiles covering area up to date for a display scale. */
+    void render(juce::Rectangle<int> area, float scale)
+    {
+        if (area != layoutArea || scale != layoutScale)
+            layout(area, scale);
+
+        binShapes();
+
+        dirtyTiles.clear();
+
+        for (auto& tile : tiles)
+        {
+            const auto signature = hashShapes(tile);
+
+            if (signature != tile.signature)
+            {
+                tile.signature = signature;
+                dirtyTiles.push_back(&tile);
+            }
+        }
+
+        const int numDirty = static_cast<int>(dirtyTiles.size());
+        const int numHelpers = juce::jmin(static_cast<int>(helpers.size()), numDirty - 1);
+
+        nextDirtyTile.store(0);
+
+        // The jobs are kept between frames, so a frame doesn't allocate any
+        for (int i = 0; i < numHelpers; ++i)
+            pool.addJob(helpers[static_cast<size_t>(i)].get(), false);
+
+        renderDirtyTiles();
+
+        for (int i = 0; i < numHelpers; ++i)
+            pool.waitForJobToFinish(helpers[static_cast<size_t>(i)].get(), -1);
+
+        numRendered = numDirty;
+    }
+
+    /** Draws the layer where render() laid it out. */
+    void draw(juce::Graphics& g) const
+    {
+        g.setOpacity(1.0f);
+
+        for (const auto& tile : tiles)
+            if (! tile.shapes.empty())
+                g.drawImage(tile.image, tile.area);
+    }
+
+    /** How many tiles the last render() had to redraw. */
+    int getNumTilesRendered() const noexcept { return numRendered; }
+
+private:
+    struct Shape
+    {
+        juce::Rectangle<float> bounds;
+        juce::Colour colour;
+        float lineThickness;
+    };
+
+    struct HelperJob : public juce::ThreadPoolJob
+    {
+        explicit HelperJob(TiledLayer& l) : juce::ThreadPoolJob("Tekhne tiles"), layer(l) {}
+
+        JobStatus runJob() override
+        {
+            layer.renderDirtyTiles();
+            return jobHasFinished;
+        }
+
+        TiledLayer& layer;
+    };
+
+    struct Tile
+    {
+        juce::Rectangle<float> area;        // logical pixels
+        juce::Image image;                  // physical pixels
+        std::vector<int> shapes;            // indices into shapes, in drawing order
+        juce::uint64 signature = 0;
+    };
+
+    void layout(juce::Rectangle<int> area, float scale)
+    {
+        layoutArea = area;
+        layoutScale = scale;
+
+        const int physicalWidth = juce::roundToInt(std::ceil(static_cast<float>(area.getWidth()) * scale));
+        const int physicalHeight = juce::roundToInt(std::ceil(static_cast<float>(area.getHeight()) * scale));
+
+        columns = (physicalWidth + tileSize - 1) / tileSize;
+        rows = (physicalHeight + tileSize - 1) / tileSize;
+        tiles.clear();
+        tiles.resize(static_cast<size_t>(columns * rows));
+
+        for (int row = 0; row < rows; ++row)
+        {
+            for (int column = 0; column < columns; ++column)
+            {
+                const int x = column * tileSize;
+                const int y = row * tileSize;
+                const int width = juce::jmin(tileSize, physicalWidth - x);
+                const int height = juce::jmin(tileSize, physicalHeight - y);
+
+                auto& tile = tiles[static_cast<size_t>(row * columns + column)];
+                tile.area = { static_cast<float>(area.getX()) + static_cast<float>(x) / scale,
+                              static_cast<float>(area.getY()) + static_cast<float>(y) / scale,
+                              static_cast<float>(width) / scale,
+                              static_cast<float>(height) / scale };
+                tile.image = juce::Image(juce::Image::ARGB, width, height, true, juce::SoftwareImageType());
+            }
+        }
+    }
+
+    // Each shape goes to the tiles under its bounds that it actually reaches
+    void binShapes()
+    {
+        for (auto& tile : tiles)
+            tile.shapes.clear();
+
+        const float tileArea = static_cast<float>(tileSize) / layoutScale;
+
+        for (int i = 0; i < static_cast<int>(shapes.size()); ++i)
+        {
+            const auto& shape = shapes[static_cast<size_t>(i)];
+            const auto reach = shape.bounds.expanded(shape.lineThickness * 0.5f + 1.0f);
+
+            const int firstColumn = juce::jmax(0, static_cast<int>((reach.getX() - static_cast<float>(layoutArea.getX())) / tileArea));
+            const int lastColumn = juce::jmin(columns - 1, static_cast<int>((reach.getRight() - static_cast<float>(layoutArea.getX())) / tileArea));
+            const int firstRow = juce::jmax(0, static_cast<int>((reach.getY() - static_cast<float>(layoutArea.getY())) / tileArea));
+            const int lastRow = juce::jmin(rows - 1, static_cast<int>((reach.getBottom() - static_cast<float>(layoutArea.getY())) / tileArea));
+
+            for (int row = firstRow; row <= lastRow; ++row)
+            {
+                for (int column = firstColumn; column <= lastColumn; ++column)
+                {
+                    auto& tile = tiles[static_cast<size_t>(row * columns + column)];
+
+                    if (reaches(shape, tile.area))
+                        tile.shapes.push_back(i);
+                }
+            }
+        }
+    }
+
+    // A circle misses a tile in the corners of its bounds, and an outlined
+    // one misses a tile that sits wholly inside its inner edge
+    static bool reaches(const Shape& shape, juce::Rectangle<float> area) noexcept
+    {
+        if (shape.bounds.getWidth() != shape.bounds.getHeight())
+            return true;
+
+        const auto centre = shape.bounds.getCentre();
+        const float radius = shape.bounds.getWidth() * 0.5f;
+        const float outer = radius + shape.lineThickness * 0.5f + 1.0f;
+
+        const float nearX = juce::jlimit(area.getX(), area.getRight(), centre.x) - centre.x;
+        const float nearY = juce::jlimit(area.getY(), area.getBottom(), centre.y) - centre.y;
+
+        if (nearX * nearX + nearY * nearY > outer * outer)
+            return false;
+
+        const float hole = radius - shape.lineThickness * 0.5f - 1.0f;
+
+        if (shape.lineThickness <= 0.0f || hole <= 0.0f)
+            return true;
+
+        const float farX = juce::jmax(std::abs(centre.x - area.getX()), std::abs(centre.x - area.getRight()));
+        const float farY = juce::jmax(std::abs(centre.y - area.getY()), std::abs(centre.y - area.getBottom()));
+
+        return farX * farX + farY * farY >= hole * hole;
+    }
+
+    // FNV-1a over everything that decides a tile's pixels
+    juce::uint64 hashShapes(const Tile& tile) const noexcept
+    {
+        juce::uint64 hash = 14695981039346656037ull;
+
+        auto add = [&hash](juce::uint32 bits)
+        {
+            hash = (hash ^ bits) * 1099511628211ull;
+        };
+
+        auto addFloat = [&add](float value)
+        {
+            juce::uint32 bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            add(bits);
+        };
+
+        for (const int i : tile.shapes)
+        {
+            const auto& shape = shapes[static_cast<size_t>(i)];
+            addFloat(shape.bounds.getX());
+            addFloat(shape.bounds.getY());
+            addFloat(shape.bounds.getWidth());
+            addFloat(shape.bounds.getHeight());
+            addFloat(shape.lineThickness);
+            add(shape.colour.getARGB());
+        }
+
+        add(static_cast<juce::uint32>(tile.shapes.size()));
+        return hash;
+    }
+
+    // Any thread: takes dirty tiles until none are left
+    void renderDirtyTiles()
+    {
+        const int numDirty = static_cast<int>(dirtyTiles.size());
+
+        for (int i = nextDirtyTile++; i < numDirty; i = nextDirtyTile++)
+            renderTile(*dirtyTiles[static_cast<size_t>(i)]);
+    }
+
+    void renderTile(Tile& tile) const
+    {
+        tile.image.clear(tile.image.getBounds());
+
+        if (tile.shapes.empty())
+            return;
+
+        juce::Graphics g(tile.image);
+        g.addTransform(juce::AffineTransform::translation(-tile.area.getX(), -tile.area.getY()).scaled(layoutScale));
+
+        for (const int i : tile.shapes)
+        {
+            const auto& shape = shapes[static_cast<size_t>(i)];
+            g.setColour(shape.colour);
+
+            if (shape.lineThickness > 0.0f)
+                g.drawEllipse(shape.bounds, shape.lineThickness);
+            else
+                g.fillEllipse(shape.bounds);
+        }
+    }
+
+    std::vector<Shape> shapes;
+    std::vector<Tile> tiles;
+    std::vector<Tile*> dirtyTiles;
+    juce::Rectangle<int> layoutArea;
+    float layoutScale = 0.0f;
+    int columns = 0, rows = 0;
+    int numRendered = 0;
+
+    std::vector<std::unique_ptr<HelperJob>> helpers;
+    std::atomic<int> nextDirtyTile { 0 };
+    juce::ThreadPool pool;                  // last, so it stops before the rest goes
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TiledLayer)
+};
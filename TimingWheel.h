@@ -0,0 +1,142 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/*
+    Two-level hashed timing wheel for events due at millisecond timestamps.
+
+    Time is cut into ticks of tickMs. The inner wheel has a slot per tick
+    for the next innerSlots ticks; the outer wheel has a slot per whole turn
+    of the inner one, and a turn's events drop into the inner wheel when it
+    comes round. Anything further out waits in an overflow list that is
+    looked at once per turn.
+
+    advance() walks the ticks that have passed and hands over every event
+    in them, with the exact timestamp it was scheduled for, so callers can
+    act as if it had fired on time however late the call is. Scheduling is
+    constant time, and a call costs the ticks passed plus the events due,
+    not the number of events waiting. Events due in the same tick fire in
+    timestamp order.
+
+    Not thread safe; keep it on one thread.
+*/
+template <typename Payload>
+class TimingWheel
+{
+public:
+    static constexpr int innerBits = 8;
+    static constexpr int innerSlots = 1 << innerBits;
+    static constexpr int outerSlots = 64;
+
+    explicit TimingWheel(juce::int64 tickLengthMs = 10) noexcept
+        : tickMs(juce::jmax<juce::int64>(1, tickLengthMs))
+    {
+    }
+
+    /** Drops every event and restarts the clock at nowMs. */
+    void reset(juce::int64 nowMs)
+    {
+        for (auto& slot : inner) slot.clear();
+        for (auto& slot : outer) slot.clear();
+        overflow.clear();
+
+        currentTick = toTick(nowMs);
+        numEvents = 0;
+    }
+
+    /** Events already due fire on the next advance(). */
+    void schedule(juce::int64 dueMs, Payload payload)
+    {
+        insert({ dueMs, std::move(payload) }, currentTick + 1);
+        ++numEvents;
+    }
+
+    /** Calls fire(dueMs, payload) for every event due by nowMs. fire may schedule more. */
+    template <typename Callback>
+    void advance(juce::int64 nowMs, Callback&& fire)
+    {
+        const auto targetTick = toTick(nowMs);
+
+        while (currentTick < targetTick)
+        {
+            ++currentTick;
+
+            if ((currentTick & (innerSlots - 1)) == 0)
+                cascade();
+
+            auto& slot = inner[static_cast<size_t>(currentTick & (innerSlots - 1))];
+
+            if (slot.empty())
+                continue;
+
+            // Swapped out so fire() can schedule into the wheel while we walk it
+            due.swap(slot);
+            std::sort(due.begin(), due.end(), [](const Entry& a, const Entry& b) { return a.dueMs < b.dueMs; });
+            numEvents -= static_cast<int>(due.size());
+
+            for (auto& entry : due)
+                fire(entry.dueMs, std::move(entry.payload));
+
+            due.clear();
+        }
+    }
+
+    int size() const noexcept { return numEvents; }
+
+private:
+    struct Entry
+    {
+        juce::int64 dueMs;
+        Payload payload;
+    };
+
+    juce::int64 toTick(juce::int64 ms) const noexcept
+    {
+        return ms >= 0 ? ms / tickMs : (ms - tickMs + 1) / tickMs;
+    }
+
+    // Late events go in earliestTick, which advance() still has to visit
+    void insert(Entry entry, juce::int64 earliestTick)
+    {
+        const auto tick = juce::jmax(toTick(entry.dueMs), earliestTick);
+
+        if (tick - currentTick < innerSlots)
+            inner[static_cast<size_t>(tick & (innerSlots - 1))].push_back(std::move(entry));
+        else if ((tick >> innerBits) - (currentTick >> innerBits) < outerSlots)
+            outer[static_cast<size_t>((tick >> innerBits) % outerSlots)].push_back(std::move(entry));
+        else
+            overflow.push_back(std::move(entry));
+    }
+
+    // The inner wheel has just started a new turn: move that turn's events in
+    void cascade()
+    {
+        auto& slot = outer[static_cast<size_t>((currentTick >> innerBits) % outerSlots)];
+        due.swap(slot);
+
+        for (auto& entry : due)
+            insert(std::move(entry), currentTick);
+
+        due.clear();
+
+        if (overflow.empty())
+            return;
+
+        due.swap(overflow);
+
+        for (auto& entry : due)
+            insert(std::move(entry), currentTick);
+
+        due.clear();
+    }
+
+    std::array<std::vector<Entry>, innerSlots> inner;
+    std::array<std::vector<Entry>, outerSlots> outer;
+    std::vector<Entry> overflow;
+    std::vector<Entry> due;
+
+    juce::int64 tickMs;
+    juce::int64 currentTick = 0;
+    int numEvents = 0;
+};
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/*
+    Scale tables and pitch quantisation shared by the processor and the editor.
+
+    Equal-tempered tables for any mode, root note and octave range are built at
+    compile time with makeEqualTemperedScale(). Tuning wraps such a table (or one
+    loaded from a Scala .scl file at runtime) and snaps frequencies to the
+    nearest degree in pitch space with an O(1) lookup on log2(frequency).
+*/
+
+namespace TuningMath
+{
+    /** constexpr 2^x, accurate to double precision over the audible range. */
+    constexpr double exp2(double x)
+    {
+        double scale = 1.0;
+
+        while (x >= 1.0) { scale *= 2.0; x -= 1.0; }
+        while (x < 0.0)  { scale *= 0.5; x += 1.0; }
+
+        // e^(x * ln2) for x in [0, 1)
+        const double y = x * 0.693147180559945309417;
+        double term = 1.0;
+        double sum = 1.0;
+
+        for (int n = 1; n < 24; ++n)
+        {
+            term *= y / n;
+            sum += term;
+        }
+
+        return scale * sum;
+    }
+
+    constexpr double midiNoteToFrequency(int midiNote, double concertA = 440.0)
+    {
+        return concertA * exp2((midiNote - 69) / 12.0);
+    }
+}
+
+//==============================================================================
+/** Semitone offsets from the root for the common diatonic modes. */
+namespace ScaleModes
+{
+    constexpr std::array<int, 7> ionian     { 0, 2, 4, 5, 7, 9, 11 };
+    constexpr std::array<int, 7> dorian     { 0, 2, 3, 5, 7, 9, 10 };
+    constexpr std::array<int, 7> phrygian   { 0, 1, 3, 5, 7, 8, 10 };
+    constexpr std::array<int, 7> lydian     { 0, 2, 4, 6, 7, 9, 11 };
+    constexpr std::array<int, 7> mixolydian { 0, 2, 4, 5, 7, 9, 10 };
+    constexpr std::array<int, 7> aeolian    { 0, 2, 3, 5, 7, 8, 10 };
+    constexpr std::array<int, 7> locrian    { 0, 1, 3, 5, 6, 8, 10 };
+    constexpr std::array<int, 5> majorPentatonic { 0, 2, 4, 7, 9 };
+}
+
+/** Builds an equal-tempered scale table at compile time, lowest note first. */
+template <size_t NumOctaves, size_t NumDegrees>
+constexpr std::array<float, NumDegrees * NumOctaves> makeEqualTemperedScale(const std::array<int, NumDegrees>& mode,
+                                                                            int rootMidiNote,
+                                                                            double concertA = 440.0)
+{
+    std::array<float, NumDegrees * NumOctaves> frequencies {};
+
+    for (size_t octave = 0; octave < NumOctaves; ++octave)
+        for (size_t degree = 0; degree < NumDegrees; ++degree)
+            frequencies[octave * NumDegrees + degree] = static_cast<float>(TuningMath::midiNoteToFrequency(rootMidiNote + static_cast<int>(octave) * 12 + mode[degree], concertA));
+
+    return frequencies;
+}
+
+/** Lydian on C, octaves 3 to 6 - the scale Tekhne has always quantised to. */
+constexpr auto lydianScaleFrequencies = makeEqualTemperedScale<4>(ScaleModes::lydian, 48);
+
+//==============================================================================
+class Tuning
+{
+public:
+    Tuning() : Tuning(lydianScaleFrequencies.data(), lydianScaleFrequencies.size()) {}
+
+    template <size_t Size>
+    explicit Tuning(const std::array<float, Size>& table) : Tuning(table.data(), table.size()) {}
+
+    Tuning(const float* frequencies, size_t numFrequencies)
+    {
+        build(std::vector<float>(frequencies, frequencies + numFrequencies));
+    }
+
+    /** Parses the contents of a Scala .scl file and spreads it over numPeriods
+        repetitions of its period, starting at rootFrequency.
+    */
+    static juce::Result fromScala(const juce::String& sclText, double rootFrequency, int numPeriods, Tuning& result)
+    {
+        std::vector<double> ratios;
+        int expectedCount = -1;
+        bool hasDescription = false;
+
+        for (auto line : juce::StringArray::fromLines(sclText))
+        {
+            line = line.trim();
+
+            if (line.startsWithChar('!'))
+                continue;
+
+            if (! hasDescription)
+            {
+                hasDescription = true; // first non-comment line is free text and may be empty
+                continue;
+            }
+
+            if (line.isEmpty())
+                continue;
+
+            if (expectedCount < 0)
+            {
+                expectedCount = line.getIntValue();
+                continue;
+            }
+
+            auto pitch = line.upToFirstOccurrenceOf(" ", false, false);
+
+            if (pitch.containsChar('.'))
+                ratios.push_back(TuningMath::exp2(pitch.getDoubleValue() / 1200.0));
+            else if (pitch.containsChar('/'))
+                ratios.push_back(pitch.upToFirstOccurrenceOf("/", false, false).getDoubleValue()
+                                 / pitch.fromFirstOccurrenceOf("/", false, false).getDoubleValue());
+            else
+                ratios.push_back(pitch.getDoubleValue());
+
+            if (ratios.back() <= 0.0)
+                return juce::Result::fail("Invalid pitch in Scala file: " + line);
+        }
+
+        if (expectedCount <= 0 || static_cast<int>(ratios.size()) != expectedCount)
+            return juce::Result::fail("Scala file does not contain the number of pitches it declares");
+
+        if (rootFrequency <= 0.0 || numPeriods <= 0)
+            return juce::Result::fail("Invalid root frequency or period count");
+
+        // The last entry is the period (usually 2/1); the root itself is implicit.
+        const double period = ratios.back();
+        std::vector<float> frequencies;
+        double periodBase = rootFrequency;
+
+        for (int p = 0; p < numPeriods; ++p)
+        {
+            frequencies.push_back(static_cast<float>(periodBase));
+
+            for (size_t i = 0; i + 1 < ratios.size(); ++i)
+                frequencies.push_back(static_cast<float>(periodBase * ratios[i]));
+
+            periodBase *= period;
+        }
+
+        std::sort(frequencies.begin(), frequencies.end());
+        frequencies.erase(std::unique(frequencies.begin(), frequencies.end()), frequencies.end());
+
+        result.build(std::move(frequencies));
+        return juce::Result::ok();
+    }
+
+    //==============================================================================
+    /** Returns the scale degree closest to frequency in pitch space. Negative
+        frequencies (a carrier swept through zero) keep their sign.
+    */
+    float quantise(float frequency) const noexcept
+    {
+        if (frequency < 0.0f)
+            return -degrees[static_cast<size_t>(nearestDegree(-frequency))];
+
+        return degrees[static_cast<size_t>(nearestDegree(frequency))];
+    }
+
+    int nearestDegree(float frequency) const noexcept
+    {
+        // Written so NaN lands here too, rather than in the cast below
+        if (! (frequency > degrees.front()))
+            return 0;
+
+        // Also catches infinity and anything past the grid before it reaches the cast
+        if (frequency >= degrees.back())
+            return static_cast<int>(degrees.size()) - 1;
+
+        const float logFrequency = std::log2(frequency);
+        const int bin = static_cast<int>((logFrequency - gridStart) * binsPerOctave);
+
+        if (bin >= static_cast<int>(grid.size()))
+            return static_cast<int>(degrees.size()) - 1;
+
+        // Bins are narrower than the gap between neighbouring decision boundaries,
+        // so this advances at most once unless the grid had to be capped.
+        int index = grid[static_cast<size_t>(bin)];
+
+        while (index + 1 < static_cast<int>(degrees.size()) && logFrequency > boundaries[static_cast<size_t>(index)])
+            ++index;
+
+        return index;
+    }
+
+    size_t size() const noexcept                    { return degrees.size(); }
+    float operator[](size_t index) const noexcept   { return degrees[index]; }
+    float getLowest() const noexcept                { return degrees.front(); }
+    float getHighest() const noexcept               { return degrees.back(); }
+
+private:
+    void build(std::vector<float> frequencies)
+    {
+        jassert(! frequencies.empty() && frequencies.size() <= std::numeric_limits<uint16_t>::max());
+        jassert(std::is_sorted(frequencies.begin(), frequencies.end()));
+
+        degrees = std::move(frequencies);
+        boundaries.clear();
+        grid.clear();
+
+        if (degrees.size() < 2)
+        {
+            gridStart = 0.0f;
+            binsPerOctave = 0.0f;
+            return;
+        }
+
+        // Decision boundaries sit halfway between neighbouring degrees in log2(Hz).
+        float smallestStep = std::numeric_limits<float>::max();
+
+        for (size_t i = 0; i + 1 < degrees.size(); ++i)
+        {
+            const float lower = std::log2(degrees[i]);
+            const float upper = std::log2(degrees[i + 1]);
+            boundaries.push_back(0.5f * (lower + upper));
+            smallestStep = juce::jmin(smallestStep, upper - lower);
+        }
+
+        const float octaves = std::log2(degrees.back()) - std::log2(degrees.front());
+        const size_t maxBins = 1 << 16;
+
+        gridStart = std::log2(degrees.front());
+        binsPerOctave = juce::jmin(2.0f / smallestStep, static_cast<float>(maxBins) / octaves);
+        grid.resize(static_cast<size_t>(std::ceil(octaves * binsPerOctave)) + 1);
+
+        int index = 0;
+
+        for (size_t bin = 0; bin < grid.size(); ++bin)
+        {
+            const float binStart = gridStart + static_cast<float>(bin) / binsPerOctave;
+
+            while (index + 1 < static_cast<int>(degrees.size()) && binStart > boundaries[static_cast<size_t>(index)])
+                ++index;
+
+            grid[bin] = static_cast<uint16_t>(index);
+        }
+    }
+
+    std::vector<float> degrees;
+    std::vector<float> boundaries;
+    std::vector<uint16_t> grid;
+
+    float gridStart = 0.0f;
+    float binsPerOctave = 0.0f;
+
+    JUCE_LEAK_DETECTOR(Tuning)
+};
@@ -0,0 +1,302 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "DSPKernels.h"
+#include "MultiProducerQueue.h"
+
+//==============================================================================
+/*
+    The pond as a damped 2D wave equation on a square height field, stepped
+    on its own thread.
+
+    The grid covers the pond's bounding square, from -1 to 1 pond radii on
+    each axis. Two fields leapfrog: each step writes the new heights over
+    the step before, one DSPKernels::stepWaveRow per row. A border of zeros
+    holds the edges still, so the rows need no edge cases. Finer grids take
+    more steps per frame, so waves cross the pond at the same speed and die
+    away at the same rate whatever the size.
+
+    Other threads talk to it without waiting on a step:
+      - addImpulse() queues a drop, picked up before the next step.
+      - setProbePosition() and getProbeHeight() sample the surface at up to
+        maxProbes points; the heights are refreshed after every frame.
+      - getLatestField() copies the newest published frame. Frames are
+        double-buffered, so the lock only covers the copy and the swap.
+
+    When the surface has settled the thread sleeps until the next impulse.
+*/
+class WaterSimulation : private juce::Thread
+{
+public:
+    static constexpr int maxProbes = 4;
+    static constexpr double framesPerSecond = 60.0;
+    static constexpr float courant = 0.25f;            // (c dt / dx)^2; the scheme is stable up to 0.5
+
+    explicit WaterSimulation(int size = 256)
+        : juce::Thread("Tekhne water"),
+          gridSize(juce::jlimit(16, 512, size)),
+          stride(gridSize + 2),
+          stepsPerFrame(juce::jmax(1, gridSize / 128)),
+          kernels(DSPKernels::select())
+    {
+        setViscosity(0.5f);
+
+        for (auto& field : fields)
+            field.assign(static_cast<size_t>(stride * stride), 0.0f);
+
+        for (auto& frame : frames)
+            frame.assign(static_cast<size_t>(gridSize * gridSize), 0.0f);
+    }
+
+    ~WaterSimulation() override
+    {
+        stopThread(1000);
+    }
+
+    int getGridSize() const noexcept { return gridSize; }
+
+    /** Message thread. */
+    void start()
+    {
+        if (! isThreadRunning())
+            startThread();
+    }
+
+    void stop()
+    {
+        stopThread(1000);
+    }
+
+    //==============================================================================
+    /** Any thread: 0 is the thinnest water, where a wave keeps 90% of its
+        height each second, 1 the thickest, where it keeps 5%.
+    */
+    void setViscosity(float viscosity) noexcept
+    {
+        const double retainedPerSecond = juce::jmap(static_cast<double>(juce::jlimit(0.0f, 1.0f, viscosity)), 0.9, 0.05);
+
+        // The leapfrog loses the square root of the damping per step
+        damping.store(static_cast<float>(std::pow(retainedPerSecond, 2.0 / (framesPerSecond * stepsPerFrame))));
+    }
+
+    /** Any thread: drops a smooth bump of the given height, at a position in pond radii.
+        Dropped if too many are already waiting.
+    */
+    void addImpulse(juce::Point<float> position, float strength)
+    {
+        if (impulses.push({ position, strength }))
+            notify();
+    }
+
+    /** Any thread, including the audio thread. */
+    void setProbePosition(int probe, juce::Point<float> position) noexcept
+    {
+        auto& p = probes[static_cast<size_t>(probe)];
+        p.x.store(position.x, std::memory_order_relaxed);
+        p.y.store(position.y, std::memory_order_relaxed);
+    }
+
+    /** Any thread, including the audio thread: the surface height at the probe after the latest frame. */
+    float getProbeHeight(int probe) const noexcept
+    {
+        return probes[static_cast<size_t>(probe)].height.load(std::memory_order_relaxed);
+    }
+
+    /** Copies the newest frame, gridSize rows of gridSize heights, if it isn't
+        lastFrame. Updates lastFrame and returns true if it copied.
+    */
+    bool getLatestField(std::vector<float>& heights, juce::uint32& lastFrame)
+    {
+        const juce::SpinLock::ScopedLockType sl(frameLock);
+
+        if (frameNumber == lastFrame)
+            return false;
+
+        heights = frames[static_cast<size_t>(frontFrame)];
+        lastFrame = frameNumber;
+        return true;
+    }
+
+private:
+    struct Impulse
+    {
+        juce::Point<float> position;
+        float strength;
+    };
+
+    struct Probe
+    {
+        std::atomic<float> x { 0.0f }, y { 0.0f };
+        std::atomic<float> height { 0.0f };
+    };
+
+    //==============================================================================
+    void run() override
+    {
+        const double frameMs = 1000.0 / framesPerSecond;
+        auto nextFrameMs = juce::Time::getMillisecondCounterHiRes();
+        bool settled = true;
+
+        while (! threadShouldExit())
+        {
+            if (applyImpulses())
+                settled = false;
+
+            if (settled)
+            {
+                wait(-1);
+                nextFrameMs = juce::Time::getMillisecondCounterHiRes();
+                continue;
+            }
+
+            for (int i = 0; i < stepsPerFrame; ++i)
+                step();
+
+            settled = publish();
+
+            // If a frame ran late, carry on from now rather than rushing to catch up
+            nextFrameMs += frameMs;
+            const auto nowMs = juce::Time::getMillisecondCounterHiRes();
+
+            if (nextFrameMs > nowMs)
+                wait(nextFrameMs - nowMs);
+            else
+                nextFrameMs = nowMs;
+        }
+    }
+
+    float* getCell(int field, int x, int y) noexcept
+    {
+        return fields[static_cast<size_t>(field)].data() + (y + 1) * stride + (x + 1);
+    }
+
+    float toGrid(float pondRadii) const noexcept
+    {
+        return (pondRadii + 1.0f) * 0.5f * static_cast<float>(gridSize) - 0.5f;
+    }
+
+    bool applyImpulses()
+    {
+        return impulses.popAll([this](const Impulse& impulse) { applyImpulse(impulse); }) > 0;
+    }
+
+    // A raised cosine on both fields, so the bump starts at rest and spreads as a ring
+    void applyImpulse(const Impulse& impulse)
+    {
+        const float radius = juce::jmax(2.0f, static_cast<float>(gridSize) / 64.0f);
+        const float cx = toGrid(impulse.position.x);
+        const float cy = toGrid(impulse.position.y);
+
+        const int x0 = juce::jmax(0, static_cast<int>(std::floor(cx - radius)));
+        const int x1 = juce::jmin(gridSize - 1, static_cast<int>(std::ceil(cx + radius)));
+        const int y0 = juce::jmax(0, static_cast<int>(std::floor(cy - radius)));
+        const int y1 = juce::jmin(gridSize - 1, static_cast<int>(std::ceil(cy + radius)));
+
+        for (int y = y0; y <= y1; ++y)
+        {
+            for (int x = x0; x <= x1; ++x)
+            {
+                const float distance = std::hypot(static_cast<float>(x) - cx, static_cast<float>(y) - cy);
+
+                if (distance >= radius)
+                    continue;
+
+                const float height = impulse.strength * 0.5f * (1.0f + std::cos(juce::MathConstants<float>::pi * distance / radius));
+                *getCell(0, x, y) += height;
+                *getCell(1, x, y) += height;
+            }
+        }
+    }
+
+    void step()
+    {
+        const float k = damping.load();
+        const int previous = 1 - current;
+
+        for (int y = 0; y < gridSize; ++y)
+            kernels.stepWaveRow(getCell(previous, 0, y), getCell(current, 0, y - 1), getCell(current, 0, y),
+                                getCell(current, 0, y + 1), courant, k, gridSize);
+
+        current = previous;
+    }
+
+    // Updates the probes and hands the new frame over; true once the water is flat
+    bool publish()
+    {
+        for (auto& probe : probes)
+            probe.height.store(sample(probe.x.load(std::memory_order_relaxed), probe.y.load(std::memory_order_relaxed)),
+                               std::memory_order_relaxed);
+
+        const int back = 1 - frontFrame;
+        auto& frame = frames[static_cast<size_t>(back)];
+        float peak = 0.0f;
+
+        for (int y = 0; y < gridSize; ++y)
+        {
+            auto* row = frame.data() + y * gridSize;
+            juce::FloatVectorOperations::copy(row, getCell(current, 0, y), gridSize);
+
+            const auto range = juce::FloatVectorOperations::findMinAndMax(row, gridSize);
+            peak = juce::jmax(peak, -range.getStart(), range.getEnd());
+        }
+
+        const bool flat = peak < 1.0e-4f;
+
+        if (flat)
+        {
+            // Settle exactly, so nothing lingers under the threshold
+            for (auto& field : fields)
+                std::fill(field.begin(), field.end(), 0.0f);
+
+            std::fill(frame.begin(), frame.end(), 0.0f);
+
+            for (auto& probe : probes)
+                probe.height.store(0.0f, std::memory_order_relaxed);
+        }
+
+        const juce::SpinLock::ScopedLockType sl(frameLock);
+        frontFrame = back;
+        ++frameNumber;
+
+        return flat;
+    }
+
+    // Bilinear, with positions outside the pond clamped to its edge
+    float sample(float px, float py) noexcept
+    {
+        const float gx = juce::jlimit(0.0f, static_cast<float>(gridSize - 1), toGrid(px));
+        const float gy = juce::jlimit(0.0f, static_cast<float>(gridSize - 1), toGrid(py));
+        const int x = juce::jmin(static_cast<int>(gx), gridSize - 2);
+        const int y = juce::jmin(static_cast<int>(gy), gridSize - 2);
+        const float fx = gx - static_cast<float>(x);
+        const float fy = gy - static_cast<float>(y);
+
+        const float* top = getCell(current, x, y);
+        const float* bottom = getCell(current, x, y + 1);
+        const float upper = top[0] + fx * (top[1] - top[0]);
+        const float lower = bottom[0] + fx * (bottom[1] - bottom[0]);
+
+        return upper + fy * (lower - upper);
+    }
+
+    //==============================================================================
+    const int gridSize;
+    const int stride;                           // gridSize plus the zero border on each side
+    const int stepsPerFrame;
+    const DSPKernels& kernels;
+
+    std::array<std::vector<float>, 2> fields;   // simulation thread only
+    int current = 0;
+
+    std::atomic<float> damping { 1.0f };
+    std::array<Probe, maxProbes> probes;
+
+    MultiProducerQueue<Impulse, 64> impulses;
+
+    std::array<std::vector<float>, 2> frames;
+    int frontFrame = 0;
+    juce::uint32 frameNumber = 0;
+    juce::SpinLock frameLock;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaterSimulation)
+};
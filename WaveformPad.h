@@ -0,0 +1,106 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/*
+    A pad for drawing one cycle of the "Drawn" waveform by dragging across it.
+
+    The cycle is numPoints values from -1 to 1, left to right. A drag sets
+    every point it passes over, filling in between mouse events so a quick
+    stroke leaves no gaps. onCycleDrawn is only called on mouse-up, since
+    each call builds a new wavetable.
+*/
+class WaveformPad : public juce::Component
+{
+public:
+    static constexpr int numPoints = 256;
+
+    WaveformPad()
+    {
+        // Starts out as the sine the Drawn waveform plays until something is drawn
+        for (int i = 0; i < numPoints; ++i)
+            cycle[static_cast<size_t>(i)] = std::sin(juce::MathConstants<float>::twoPi * static_cast<float>(i) / numPoints);
+    }
+
+    /** Called on mouse-up with the whole cycle. */
+    std::function<void(const float* cycle, int numPoints)> onCycleDrawn;
+
+    void paint(juce::Graphics& g) override
+    {
+        g.fillAll(juce::Colours::black.withAlpha(0.5f));
+        g.setColour(juce::Colours::white.withAlpha(0.2f));
+        g.drawHorizontalLine(getHeight() / 2, 0.0f, static_cast<float>(getWidth()));
+
+        juce::Path trace;
+
+        for (int i = 0; i < numPoints; ++i)
+        {
+            const auto point = getPosition(i);
+
+            if (i == 0)
+                trace.startNewSubPath(point);
+            else
+                trace.lineTo(point);
+        }
+
+        g.setColour(juce::Colours::white);
+        g.strokePath(trace, juce::PathStrokeType(1.0f));
+    }
+
+    void mouseDown(const juce::MouseEvent& event) override
+    {
+        lastPoint = -1;
+        draw(event.position);
+    }
+
+    void mouseDrag(const juce::MouseEvent& event) override
+    {
+        draw(event.position);
+    }
+
+    void mouseUp(const juce::MouseEvent&) override
+    {
+        if (onCycleDrawn != nullptr)
+            onCycleDrawn(cycle.data(), numPoints);
+    }
+
+private:
+    juce::Point<float> getPosition(int index) const noexcept
+    {
+        const float middle = static_cast<float>(getHeight()) * 0.5f;
+
+        return { static_cast<float>(index) * static_cast<float>(getWidth()) / (numPoints - 1),
+                 middle - cycle[static_cast<size_t>(index)] * middle };
+    }
+
+    void draw(juce::Point<float> position)
+    {
+        if (getWidth() <= 0 || getHeight() <= 0)
+            return;
+
+        const int point = juce::jlimit(0, numPoints - 1, juce::roundToInt(position.x * (numPoints - 1) / static_cast<float>(getWidth())));
+        const float value = juce::jlimit(-1.0f, 1.0f, 1.0f - 2.0f * position.y / static_cast<float>(getHeight()));
+
+        // Joins this point to the last one with a straight line
+        const int from = lastPoint < 0 ? point : lastPoint;
+        const float fromValue = lastPoint < 0 ? value : lastValue;
+        const int step = point >= from ? 1 : -1;
+
+        for (int i = from; i != point + step; i += step)
+        {
+            const float fraction = point == from ? 1.0f : static_cast<float>(i - from) / static_cast<float>(point - from);
+            cycle[static_cast<size_t>(i)] = fromValue + fraction * (value - fromValue);
+        }
+
+        lastPoint = point;
+        lastValue = value;
+        repaint();
+    }
+
+    std::array<float, numPoints> cycle;
+    int lastPoint = -1;
+    float lastValue = 0.0f;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaveformPad)
+};
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/*
+    Oscillator shapes beyond the plain sine. The sine keeps its own table in
+    SharedDSPTables and its own SIMD kernels.
+*/
+enum class Waveform
+{
+    sine = 0,
+    saw,
+    square,
+    triangle,
+    drawn
+};
+
+inline juce::StringArray getWaveformNames()
+{
+    return { "Sine", "Saw", "Square", "Triangle", "Drawn" };
+}
+
+//==============================================================================
+/*
+    One single-cycle waveform as a stack of band-limited tables, one per octave.
+
+    Level L holds harmonics up to 2^L. It is used while the oscillator's
+    fundamental is below 1/2^(L+1) cycles per sample, so nothing it plays
+    can alias. The level depends only on the phase increment, so the tables
+    work at any sample rate.
+
+    Building one runs an FFT per level and allocates. Do it off the audio
+    thread, then treat the table as immutable.
+*/
+class MipmappedWavetable
+{
+public:
+    static constexpr int fftOrder = 11;
+    static constexpr int tableSize = 1 << fftOrder;
+    static constexpr int numLevels = fftOrder;      // the top level holds all tableSize / 2 harmonics
+    static constexpr double radiansToIndex = tableSize / juce::MathConstants<double>::twoPi;
+
+    /** Builds the levels from a spectrum: harmonics[n] is harmonic n as cos + i sin amplitudes, [0] is ignored. */
+    explicit MipmappedWavetable(const std::vector<std::complex<float>>& harmonics)
+    {
+        juce::dsp::FFT fft(fftOrder);
+        std::vector<float> data(2 * tableSize);
+
+        for (int level = 0; level < numLevels; ++level)
+        {
+            const int numHarmonics = juce::jmin(1 << level, static_cast<int>(harmonics.size()) - 1, tableSize / 2 - 1);
+
+            std::fill(data.begin(), data.end(), 0.0f);
+
+            // a cos + b sin is the real part of (a - ib) e^(i theta)
+            for (int n = 1; n <= numHarmonics; ++n)
+            {
+                data[static_cast<size_t>(2 * n)] = harmonics[static_cast<size_t>(n)].real();
+                data[static_cast<size_t>(2 * n + 1)] = -harmonics[static_cast<size_t>(n)].imag();
+            }
+
+            fft.performRealOnlyInverseTransform(data.data());
+
+            auto& table = levels[static_cast<size_t>(level)];
+            std::copy(data.begin(), data.begin() + tableSize, table.begin());
+            table[tableSize] = table[0];
+        }
+
+        // One gain for every level, taken from the fullest, so the loudness
+        // doesn't step when the oscillator crosses an octave
+        const auto& full = levels[numLevels - 1];
+        const auto range = juce::FloatVectorOperations::findMinAndMax(full.data(), tableSize);
+        const float peak = juce::jmax(std::abs(range.getStart()), std::abs(range.getEnd()));
+
+        if (peak > 0.0f)
+            for (auto& table : levels)
+                juce::FloatVectorOperations::multiply(table.data(), 1.0f / peak, tableSize + 1);
+    }
+
+    /** A fixed shape at unit peak. Waveform::sine and Waveform::drawn give a plain sine. */
+    static std::unique_ptr<MipmappedWavetable> create(Waveform waveform)
+    {
+        std::vector<std::complex<float>> harmonics(tableSize / 2);
+
+        for (int n = 1; n < tableSize / 2; ++n)
+        {
+            const float odd = (n % 2 == 1) ? 1.0f : 0.0f;
+            float sine = 0.0f;
+
+            switch (waveform)
+            {
+                case Waveform::saw:         sine = ((n % 2 == 1) ? 1.0f : -1.0f) / static_cast<float>(n); break;
+                case Waveform::square:      sine = odd / static_cast<float>(n); break;
+                case Waveform::triangle:    sine = odd * (((n / 2) % 2 == 0) ? 1.0f : -1.0f) / static_cast<float>(n * n); break;
+                case Waveform::sine:
+                case Waveform::drawn:       sine = n == 1 ? 1.0f : 0.0f; break;
+            }
+
+            harmonics[static_cast<size_t>(n)] = { 0.0f, sine };
+        }
+
+        return std::make_unique<MipmappedWavetable>(harmonics);
+    }
+
+    /** A user-drawn cycle of any length, resampled to the table size. DC is removed. */
+    static std::unique_ptr<MipmappedWavetable> createFromCycle(const float* cycle, int numSamples)
+    {
+        jassert(numSamples > 1);
+
+        juce::dsp::FFT fft(fftOrder);
+        std::vector<float> data(2 * tableSize);
+
+        for (int i = 0; i < tableSize; ++i)
+        {
+            const double position = static_cast<double>(i) * numSamples / tableSize;
+            const int index = static_cast<int>(position);
+            const float fraction = static_cast<float>(position - index);
+            const float a = cycle[index];
+            const float b = cycle[(index + 1) % numSamples];
+            data[static_cast<size_t>(i)] = a + fraction * (b - a);
+        }
+
+        fft.performRealOnlyForwardTransform(data.data());
+
+        std::vector<std::complex<float>> harmonics(tableSize / 2);
+
+        for (int n = 1; n < tableSize / 2; ++n)
+            harmonics[static_cast<size_t>(n)] = { data[static_cast<size_t>(2 * n)], -data[static_cast<size_t>(2 * n + 1)] };
+
+        return std::make_unique<MipmappedWavetable>(harmonics);
+    }
+
+    //==============================================================================
+    /** The level to play at a phase increment in radians per sample, from the float exponent bits. */
+    static int getLevel(float radiansPerSample) noexcept
+    {
+        const float cyclesPerSample = std::abs(radiansPerSample) * static_cast<float>(1.0 / juce::MathConstants<double>::twoPi);
+
+        uint32_t bits;
+        std::memcpy(&bits, &cyclesPerSample, sizeof(bits));
+        const int exponent = static_cast<int>((bits >> 23) & 0xff) - 127; // floor(log2(cyclesPerSample))
+
+        return juce::jlimit(0, numLevels - 1, -2 - exponent);
+    }
+
+    /** Linearly interpolated lookup at any non-negative phase in radians. */
+    template <typename SampleType>
+    SampleType lookup(SampleType phase, int level) const noexcept
+    {
+        const SampleType position = phase * static_cast<SampleType>(radiansToIndex);
+        const int index = static_cast<int>(position);
+        const SampleType fraction = position - static_cast<SampleType>(index);
+        const auto* entry = levels[static_cast<size_t>(level)].data() + (index & (tableSize - 1));
+
+        return static_cast<SampleType>(entry[0]) + fraction * static_cast<SampleType>(entry[1] - entry[0]);
+    }
+
+private:
+    std::array<std::array<float, tableSize + 1>, numLevels> levels;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MipmappedWavetable)
+};